@@ -1,3 +1,4 @@
+#define NOMINMAX
 #include <windows.h>
 #include <windowsx.h>
 #include <cstdint>
@@ -8,15 +9,29 @@
 struct GUI {
 	HWND window{};
 	uint32_t *bits{};
+	uint32_t *staticBits{}; // The static layers, rasterized once per size and composited under the dynamic ones.
+	uint32_t width{}, height{};
 };
 
 static int globalOpenGUICount = 0;
 
-static void GUIPaint(MyPlugin *plugin, const bool internal) {
-	if (internal) PluginPaint(plugin, plugin->gui->bits);
+void GUIPaint(MyPlugin *plugin, const bool internal) {
+	if (internal) PluginPaint(plugin, plugin->gui->bits, plugin->gui->staticBits);
 	RedrawWindow(plugin->gui->window, nullptr, nullptr, RDW_INVALIDATE);
 }
 
+static void GUIAllocateBuffers(MyPlugin *plugin) {
+	GUI *gui = plugin->gui;
+	gui->width = plugin->guiWidth;
+	gui->height = plugin->guiHeight;
+	gui->bits = static_cast<uint32_t *>(realloc(gui->bits, gui->width * gui->height * 4));
+	gui->staticBits = static_cast<uint32_t *>(realloc(gui->staticBits, gui->width * gui->height * 4));
+
+	PluginPaintStatic(plugin, gui->staticBits);
+	memcpy(gui->bits, gui->staticBits, gui->width * gui->height * 4);
+	PluginPaint(plugin, gui->bits, gui->staticBits);
+}
+
 LRESULT CALLBACK GUIWindowProcedure(HWND window, UINT message, WPARAM wParam, LPARAM lParam) {
 	auto *plugin = reinterpret_cast<MyPlugin *>(GetWindowLongPtr(window, 0));
 
@@ -27,12 +42,13 @@ LRESULT CALLBACK GUIWindowProcedure(HWND window, UINT message, WPARAM wParam, LP
 	if (message == WM_PAINT) {
 		PAINTSTRUCT paint;
 		const HDC dc = BeginPaint(window, &paint);
-		constexpr BITMAPINFO info = { { sizeof(BITMAPINFOHEADER), GUI_WIDTH, -GUI_HEIGHT, 1, 32, BI_RGB } };
-		StretchDIBits(dc, 0, 0, GUI_WIDTH, GUI_HEIGHT, 0, 0, GUI_WIDTH, GUI_HEIGHT, plugin->gui->bits, &info, DIB_RGB_COLORS, SRCCOPY);
+		const LONG width = plugin->gui->width, height = plugin->gui->height;
+		const BITMAPINFO info = { { sizeof(BITMAPINFOHEADER), width, -height, 1, 32, BI_RGB } };
+		StretchDIBits(dc, 0, 0, width, height, 0, 0, width, height, plugin->gui->bits, &info, DIB_RGB_COLORS, SRCCOPY);
 		EndPaint(window, &paint);
 	} else if (message == WM_MOUSEMOVE) {
-		PluginProcessMouseDrag(plugin, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
-		GUIPaint(plugin, true);
+		// Drags are coalesced and repainted by the frame timer; only repaint here if it applied immediately.
+		if (PluginQueueMouseDrag(plugin, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam))) GUIPaint(plugin, true);
 	} else if (message == WM_LBUTTONDOWN) {
 		SetCapture(window); 
 		PluginProcessMousePress(plugin, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
@@ -63,17 +79,24 @@ void GUICreate(MyPlugin *plugin) {
 	}
 
 	plugin->gui->window = CreateWindow(pluginDescriptor.id, pluginDescriptor.name, WS_CHILDWINDOW | WS_CLIPSIBLINGS, 
-			CW_USEDEFAULT, 0, GUI_WIDTH, GUI_HEIGHT, GetDesktopWindow(), nullptr, nullptr, nullptr);
-	plugin->gui->bits = static_cast<uint32_t *>(calloc(1, GUI_WIDTH * GUI_HEIGHT * 4));
+			CW_USEDEFAULT, 0, plugin->guiWidth, plugin->guiHeight, GetDesktopWindow(), nullptr, nullptr, nullptr);
 	SetWindowLongPtr(plugin->gui->window, 0, reinterpret_cast<LONG_PTR>(plugin));
 
-	PluginPaint(plugin, plugin->gui->bits);
+	GUIAllocateBuffers(plugin);
+}
+
+void GUIResize(MyPlugin *plugin) {
+	if (plugin->gui->width == plugin->guiWidth && plugin->gui->height == plugin->guiHeight) return;
+	GUIAllocateBuffers(plugin);
+	SetWindowPos(plugin->gui->window, nullptr, 0, 0, plugin->guiWidth, plugin->guiHeight, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+	GUIPaint(plugin, false);
 }
 
 void GUIDestroy(MyPlugin *plugin) {
 	assert(plugin->gui);
 	DestroyWindow(plugin->gui->window);
 	free(plugin->gui->bits);
+	free(plugin->gui->staticBits);
 	free(plugin->gui);
 	plugin->gui = nullptr;
 
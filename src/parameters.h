@@ -2,4 +2,11 @@
 
 // Parameters.
 #define P_VOLUME (0)
-#define P_COUNT (1)
\ No newline at end of file
+#define P_WAVETABLE (1) // 0 is the built-in sine, n is the nth wavetable in the library.
+#define P_RELEASE (2) // Seconds for a released voice to fall by 60 dB.
+#define P_RETIRE_FLOOR (3) // Level in dB below which a released voice is retired. Not automatable.
+#define P_TUNING (4) // Frequency of A4 in Hz, which every key is tuned from.
+#define P_COUNT (5)
+
+// Parameters below this index are modulatable per note, the rest only take monophonic modulation.
+#define P_MODULATABLE_COUNT (1)
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "plugin.h"
+#include <array>
+#include <numeric>
 
 template <class T>
 void Array<T>::Insert(T newItem, uintptr_t index) {
@@ -22,6 +24,17 @@ void Array<T>::Delete(uintptr_t index) {
 template <class T>
 void Array<T>::Add(T item) { Insert(item, length); }
 
+template <class T>
+void Array<T>::Reserve(size_t count) {
+    if (count > allocated) {
+        allocated = count;
+        array = static_cast<T *>(realloc(array, allocated * sizeof(T)));
+    }
+}
+
+template <class T>
+void Array<T>::Clear() { length = 0; }
+
 template <class T>
 void Array<T>::Free() { free(array); array = nullptr; length = allocated = 0; }
 
@@ -45,38 +58,330 @@ const clap_plugin_descriptor_t pluginDescriptor = {
     },
 };
 
+// Shared by all instances; the realtime oscillator reads it instead of calling sinf.
+static const auto sineTable = [] {
+    std::array<float, SINE_TABLE_SIZE + 1> table{};
+    for (uint32_t i = 0; i <= SINE_TABLE_SIZE; i++) table[i] = sinf(i * 2.0f * 3.14159265f / SINE_TABLE_SIZE);
+    return table;
+}();
+
+// The realtime tier interpolates the sine table, the offline tier computes every sample exactly.
+template <bool highQuality>
+static void PluginRenderSine(Voice *voice, const float *gain, uint32_t frames, float *output) {
+    const float increment = voice->increment;
+    float phase = voice->phase;
+
+    for (uint32_t index = 0; index < frames; index++) {
+        float sample;
+
+        if constexpr (highQuality) {
+            sample = sinf(phase * 2.0f * 3.14159265f);
+        } else {
+            const float position = phase * SINE_TABLE_SIZE;
+            const auto integer = static_cast<uint32_t>(position);
+            sample = sineTable[integer] + (sineTable[integer + 1] - sineTable[integer]) * (position - integer);
+        }
+
+        output[index] += sample * gain[index];
+
+        phase += increment;
+        phase -= floorf(phase);
+    }
+
+    voice->phase = phase;
+}
+
+// Each voice reads the highest-detail mip level whose harmonics all stay below Nyquist at its pitch.
+// The realtime tier interpolates linearly, the offline tier uses 4-point Hermite interpolation.
+template <bool highQuality>
+static void PluginRenderWavetable(const Wavetable *wavetable, Voice *voice, const float *gain, uint32_t frames, float *output) {
+    const uint32_t frameLength = wavetable->header->frameLength;
+    const float increment = voice->increment;
+    const float level = ceilf(log2f(frameLength * increment));
+    const auto mip = static_cast<uint32_t>(std::clamp(level, 0.0f, (float) wavetable->header->mipCount - 1));
+    const float *samples = WavetableMip(wavetable, mip);
+    float phase = voice->phase;
+
+    for (uint32_t index = 0; index < frames; index++) {
+        const float position = phase * frameLength;
+        const auto integer = static_cast<uint32_t>(position);
+        const float fraction = position - integer;
+        float sample;
+
+        if constexpr (highQuality) {
+            const float y0 = samples[(integer - 1) & (frameLength - 1)], y1 = samples[integer];
+            const float y2 = samples[integer + 1], y3 = samples[(integer + 2) & (frameLength - 1)];
+            const float c1 = 0.5f * (y2 - y0), c2 = y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3, c3 = 0.5f * (y3 - y0) + 1.5f * (y1 - y2);
+            sample = ((c3 * fraction + c2) * fraction + c1) * fraction + y1;
+        } else {
+            sample = samples[integer] + (samples[integer + 1] - samples[integer]) * fraction;
+        }
+
+        output[index] += sample * gain[index];
+
+        phase += increment;
+        phase -= floorf(phase);
+    }
+
+    voice->phase = phase;
+}
+
+// Fill gain with the voice's envelope for the block. Each loop is free of dependencies between samples, so it vectorizes.
+static void PluginRenderEnvelope(Voice *voice, const RenderBlock *block, float *gain) {
+    const uint32_t frames = block->frames;
+    const float envelope = voice->envelope;
+
+    if (voice->held) {
+        // A linear attack to full level, where it then stays.
+        for (uint32_t index = 0; index < frames; index++) {
+            gain[index] = std::min(1.0f, envelope + (index + 1) * block->attackStep);
+        }
+    } else {
+        // An exponential release, computed as four interleaved chains.
+        const float coefficient = voice->stolen ? block->stealCoefficient : block->releaseCoefficient;
+        const float coefficient4 = coefficient * coefficient * coefficient * coefficient;
+        float lanes[4] = { envelope * coefficient };
+        for (uint32_t k = 1; k < 4; k++) lanes[k] = lanes[k - 1] * coefficient;
+        uint32_t index = 0;
+
+        for (; index + 4 <= frames; index += 4) {
+            for (uint32_t k = 0; k < 4; k++) {
+                gain[index + k] = lanes[k];
+                lanes[k] *= coefficient4;
+            }
+        }
+
+        for (uint32_t k = 0; index < frames; index++, k++) {
+            gain[index] = lanes[k];
+        }
+    }
+
+    voice->envelope = gain[frames - 1];
+}
+
+void PluginRenderVoice(MyPlugin *plugin, Voice *voice, const RenderBlock *block, float *output) {
+    // Inaudible; it'll be retired at the end of process().
+    if (!voice->held && voice->envelope < block->envelopeFloor) return;
+
+    float modulationStart[P_COUNT], modulationEnd[P_COUNT];
+    memcpy(modulationStart, block->monophonicStart, sizeof(modulationStart));
+    memcpy(modulationEnd, block->monophonicEnd, sizeof(modulationEnd));
+
+    for (int32_t m = voice->firstModulation; m != -1; m = plugin->modulations[m].next) {
+        Modulation *modulation = &plugin->modulations[m];
+        modulationStart[modulation->parameter] += modulation->value;
+        modulation->value += (modulation->target - modulation->value) * block->smoothing;
+        modulationEnd[modulation->parameter] += modulation->value;
+    }
+
+    const float volume = FloatClamp01(plugin->parameters[P_VOLUME] + modulationStart[P_VOLUME]);
+    const float volumeEnd = FloatClamp01(plugin->parameters[P_VOLUME] + modulationEnd[P_VOLUME]);
+    const float volumeStep = (volumeEnd - volume) / block->frames;
+
+    // Fold the volume ramp into the envelope, so the oscillators only apply a single gain per sample.
+    float gain[RENDER_BLOCK_OFFLINE];
+    assert(block->frames <= RENDER_BLOCK_OFFLINE);
+    PluginRenderEnvelope(voice, block, gain);
+
+    for (uint32_t index = 0; index < block->frames; index++) {
+        gain[index] *= (volume + volumeStep * index) * 0.2f;
+    }
+
+    if (plugin->wavetable && plugin->renderMode == CLAP_RENDER_OFFLINE) {
+        PluginRenderWavetable<true>(plugin->wavetable, voice, gain, block->frames, output);
+    } else if (plugin->wavetable) {
+        PluginRenderWavetable<false>(plugin->wavetable, voice, gain, block->frames, output);
+    } else if (plugin->renderMode == CLAP_RENDER_OFFLINE) {
+        PluginRenderSine<true>(voice, gain, block->frames, output);
+    } else {
+        PluginRenderSine<false>(voice, gain, block->frames, output);
+    }
+}
+
 void PluginRenderAudio(MyPlugin *plugin, uint32_t start, uint32_t end, float *outputL, float *outputR) {
     for (uint32_t index = start; index < end; index++) {
-        float sum = 0.0f;
+        outputL[index] = 0.0f;
+    }
+
+    if (start == end) return;
+
+    // Modulation is advanced once per block, and each voice ramps linearly between its start and end values.
+    RenderBlock block;
+    block.frames = end - start;
+    block.smoothing = 1.0f - expf(-(float) block.frames / (MODULATION_SMOOTHING_SECONDS * plugin->sampleRate));
+    block.attackStep = 1.0f / (ENVELOPE_ATTACK_SECONDS * plugin->sampleRate);
+    block.releaseCoefficient = expf(logf(0.001f) / (plugin->parameters[P_RELEASE] * plugin->sampleRate));
+    block.stealCoefficient = expf(logf(0.001f) / (ENVELOPE_STEAL_SECONDS * plugin->sampleRate));
+    block.envelopeFloor = PluginEnvelopeFloor(plugin);
 
+    for (uint32_t i = 0; i < P_COUNT; i++) {
+        block.monophonicStart[i] = plugin->modulationValues[i];
+        plugin->modulationValues[i] += (plugin->modulationTargets[i] - plugin->modulationValues[i]) * block.smoothing;
+        block.monophonicEnd[i] = plugin->modulationValues[i];
+    }
+
+    const bool parallel = plugin->renderMode == CLAP_RENDER_OFFLINE && plugin->renderPool && plugin->voices.Length() >= RENDER_PARALLEL_MIN_VOICES;
+
+    if (!parallel || !RenderPoolRender(plugin, &block, outputL + start)) {
         for (int i = 0; i < plugin->voices.Length(); i++) {
-            Voice *voice = &plugin->voices[i];
-            if (!voice->held) continue;
+            PluginRenderVoice(plugin, &plugin->voices[i], &block, outputL + start);
+        }
+    }
 
-            // New!
-            const float volume = FloatClamp01(plugin->parameters[P_VOLUME] + voice->parameterOffsets[P_VOLUME]);
-            sum += sinf(voice->phase * 2.0f * 3.14159f) * 0.2f * volume;
+    memcpy(outputR + start, outputL + start, block.frames * sizeof(float));
+}
+
+static float PluginVoiceIncrement(const MyPlugin *plugin, const Voice *voice) {
+    const float increment = plugin->keyIncrements[std::clamp<int16_t>(voice->key, 0, KEY_COUNT - 1)];
+    return voice->tuning == 0.0f ? increment : increment * exp2f(voice->tuning / 12.0f);
+}
 
-            voice->phase += 440.0f * exp2f((voice->key - 57.0f) / 12.0f) / plugin->sampleRate;
-            voice->phase -= floorf(voice->phase);
+void PluginUpdateTuning(MyPlugin *plugin) {
+    for (uint32_t key = 0; key < KEY_COUNT; key++) {
+        plugin->keyIncrements[key] = plugin->parameters[P_TUNING] * exp2f((key - 57.0f) / 12.0f) / plugin->sampleRate;
+    }
+
+    // Voices cache their increment, so bring any that are still playing up to date.
+    for (int i = 0; i < plugin->voices.Length(); i++) {
+        plugin->voices[i].increment = PluginVoiceIncrement(plugin, &plugin->voices[i]);
+    }
+}
+
+// Set the modulation target of a parameter on a single voice, taking an entry from the pool if needed.
+static void PluginSetVoiceModulation(MyPlugin *plugin, Voice *voice, uint32_t parameter, float amount) {
+    for (int32_t m = voice->firstModulation; m != -1; m = plugin->modulations[m].next) {
+        if (plugin->modulations[m].parameter == parameter) {
+            plugin->modulations[m].target = amount;
+            return;
         }
+    }
+
+    // Nothing to do for a parameter that isn't being modulated yet.
+    if (amount == 0.0f) return;
+
+    // The pool has room for every voice to modulate every parameter, so it should never run dry,
+    // but if it does, dropping the modulation beats allocating on the audio thread.
+    const int32_t m = plugin->firstFreeModulation;
+    if (m == -1) return;
+    plugin->firstFreeModulation = plugin->modulations[m].next;
+
+    // Start from zero, so that the new modulation fades in like any other change.
+    plugin->modulations[m] = { .parameter = parameter, .next = voice->firstModulation, .target = amount, .value = 0.0f };
+    voice->firstModulation = m;
+}
+
+void PluginDeleteVoice(MyPlugin *plugin, uintptr_t index) {
+    Voice *voice = &plugin->voices[index];
+
+    // Return the voice's whole modulation chain to the free list.
+    if (voice->firstModulation != -1) {
+        int32_t last = voice->firstModulation;
+        while (plugin->modulations[last].next != -1) last = plugin->modulations[last].next;
+        plugin->modulations[last].next = plugin->firstFreeModulation;
+        plugin->firstFreeModulation = voice->firstModulation;
+    }
+
+    plugin->voices.Delete(index);
+}
+
+void PluginPruneModulations(MyPlugin *plugin) {
+    // Drop entries whose modulation has been removed and has finished fading out.
+    for (int i = 0; i < plugin->voices.Length(); i++) {
+        for (int32_t *link = &plugin->voices[i].firstModulation; *link != -1; ) {
+            Modulation *modulation = &plugin->modulations[*link];
+
+            if (modulation->target == 0.0f && fabsf(modulation->value) < 1e-5f) {
+                const int32_t m = *link;
+                *link = modulation->next;
+                modulation->next = plugin->firstFreeModulation;
+                plugin->firstFreeModulation = m;
+            } else {
+                link = &modulation->next;
+            }
+        }
+    }
+}
+
+// Put every entry back on the free list, first filling the pool to its full size. Only the first call allocates,
+// which happens on activation, so later calls are safe on the audio thread.
+void PluginResetModulations(MyPlugin *plugin) {
+    plugin->modulations.Reserve(MODULATION_POOL_SIZE);
+    while (plugin->modulations.Length() < MODULATION_POOL_SIZE) plugin->modulations.Add({});
+
+    for (int32_t m = 0; m < MODULATION_POOL_SIZE; m++) {
+        plugin->modulations[m].next = m + 1 < MODULATION_POOL_SIZE ? m + 1 : -1;
+    }
+
+    plugin->firstFreeModulation = 0;
+
+    for (int i = 0; i < plugin->voices.Length(); i++) {
+        plugin->voices[i].firstModulation = -1;
+    }
+}
+
+void PluginFreeModulations(MyPlugin *plugin) {
+    plugin->modulations.Free();
+    plugin->firstFreeModulation = -1;
+
+    for (int i = 0; i < plugin->voices.Length(); i++) {
+        plugin->voices[i].firstModulation = -1;
+    }
+}
+
+void PluginSendNoteEnd(const clap_output_events_t *out, const Voice *voice) {
+    clap_event_note_t event = {};
+    event.header.size = sizeof(event);
+    event.header.time = 0;
+    event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+    event.header.type = CLAP_EVENT_NOTE_END;
+    event.header.flags = 0;
+    event.key = voice->key;
+    event.note_id = voice->noteID;
+    event.channel = voice->channel;
+    event.port_index = 0;
+    out->try_push(out, &event.header);
+}
+
+// Make room for a new voice when VOICE_MAXIMUM are sounding. Voices are kept in the order they started, so the first
+// match is the oldest. The stolen voice ends as far as the host is concerned, but keeps fading out in the headroom.
+static void PluginStealVoice(MyPlugin *plugin, const clap_output_events_t *out) {
+    int sounding = 0, oldestHeld = -1, oldestReleased = -1, oldestStolen = -1;
+
+    for (int i = 0; i < plugin->voices.Length(); i++) {
+        const Voice *voice = &plugin->voices[i];
+        if (voice->stolen) { if (oldestStolen == -1) oldestStolen = i; continue; }
+        sounding++;
+        if (voice->held && oldestHeld == -1) oldestHeld = i;
+        if (!voice->held && oldestReleased == -1) oldestReleased = i;
+    }
+
+    if (sounding >= VOICE_MAXIMUM) {
+        Voice *voice = &plugin->voices[oldestReleased != -1 ? oldestReleased : oldestHeld];
+        PluginSendNoteEnd(out, voice);
+        voice->stolen = true;
+        voice->held = false;
+    }
 
-        outputL[index] = sum;
-        outputR[index] = sum;
+    // With the headroom full of voices still fading, cut the one that has been fading longest.
+    if (plugin->voices.Length() == VOICE_CAPACITY) {
+        PluginDeleteVoice(plugin, oldestStolen != -1 ? oldestStolen : 0);
     }
 }
 
-void PluginProcessEvent(MyPlugin *plugin, const clap_event_header_t *event) {
+void PluginProcessEvent(MyPlugin *plugin, const clap_event_header_t *event, const clap_output_events_t *out) {
     if (event->space_id == CLAP_CORE_EVENT_SPACE_ID) {
         if (event->type == CLAP_EVENT_NOTE_ON || event->type == CLAP_EVENT_NOTE_OFF || event->type == CLAP_EVENT_NOTE_CHOKE) {
             const auto *noteEvent = reinterpret_cast<const clap_event_note_t *>(event);
 
             for (int i = 0; i < plugin->voices.Length(); i++) {
+                // Stolen voices have already ended, so the host's notes no longer refer to them.
+                if (plugin->voices[i].stolen) continue;
+
                 if (Voice *voice = &plugin->voices[i]; (noteEvent->key == -1 || voice->key == noteEvent->key)
                                                        && (noteEvent->note_id == -1 || voice->noteID == noteEvent->note_id)
                                                        && (noteEvent->channel == -1 || voice->channel == noteEvent->channel)) {
                     if (event->type == CLAP_EVENT_NOTE_CHOKE) {
-                        plugin->voices.Delete(i--);
+                        PluginDeleteVoice(plugin, i--);
                     } else {
                         voice->held = false;
                     }
@@ -84,17 +389,40 @@ void PluginProcessEvent(MyPlugin *plugin, const clap_event_header_t *event) {
             }
 
             if (event->type == CLAP_EVENT_NOTE_ON) {
+                PluginStealVoice(plugin, out);
+
                 Voice voice = {
                     .held = true,
+                    .stolen = false,
                     .noteID = noteEvent->note_id,
                     .channel = noteEvent->channel,
                     .key = noteEvent->key,
                     .phase = 0.0f,
+                    .tuning = 0.0f,
+                    .envelope = 0.0f,
+                    .firstModulation = -1,
                 };
 
+                voice.increment = PluginVoiceIncrement(plugin, &voice);
                 plugin->voices.Add(voice);
             }
         }
+
+        if (event->type == CLAP_EVENT_NOTE_EXPRESSION) {
+            const auto *expressionEvent = reinterpret_cast<const clap_event_note_expression_t *>(event);
+
+            // Pitch glides are applied here, once per event, so they cost nothing in the render loop.
+            if (expressionEvent->expression_id == CLAP_NOTE_EXPRESSION_TUNING) {
+                for (int i = 0; i < plugin->voices.Length(); i++) {
+                    if (Voice *voice = &plugin->voices[i]; (expressionEvent->key == -1 || voice->key == expressionEvent->key)
+                                                           && (expressionEvent->note_id == -1 || voice->noteID == expressionEvent->note_id)
+                                                           && (expressionEvent->channel == -1 || voice->channel == expressionEvent->channel)) {
+                        voice->tuning = expressionEvent->value;
+                        voice->increment = PluginVoiceIncrement(plugin, voice);
+                    }
+                }
+            }
+        }
     }
     if (event->type == CLAP_EVENT_PARAM_VALUE) {
         const auto *valueEvent = reinterpret_cast<const clap_event_param_value_t *>(event);
@@ -103,71 +431,118 @@ void PluginProcessEvent(MyPlugin *plugin, const clap_event_header_t *event) {
         plugin->parameters[i] = valueEvent->value;
         plugin->changed[i] = true;
         MutexRelease(plugin->syncParameters);
+
+        // Mapping a wavetable reads it from disk, so leave it to the main thread. WavetableAcquire brings every page
+        // in before handing it over, so the audio thread's first reads don't fault on the file.
+        if (i == P_WAVETABLE && plugin->host->request_callback) {
+            plugin->host->request_callback(plugin->host);
+        }
+
+        if (i == P_RELEASE || i == P_RETIRE_FLOOR) {
+            plugin->tailChanged = true;
+        }
+
+        if (i == P_TUNING) {
+            PluginUpdateTuning(plugin);
+        }
     }
 
     if (event->type == CLAP_EVENT_PARAM_MOD) {
         const auto *modEvent = reinterpret_cast<const clap_event_param_mod_t *>(event);
+        const auto parameter = static_cast<uint32_t>(modEvent->param_id);
+        if (parameter >= P_COUNT) return;
+
+        if (modEvent->key == -1 && modEvent->note_id == -1 && modEvent->channel == -1) {
+            // Not targeted at any note, so it applies to current and future voices alike.
+            plugin->modulationTargets[parameter] = modEvent->amount;
+            return;
+        }
+
+        if (parameter >= P_MODULATABLE_COUNT) return;
 
+        // Wildcards in the target match every voice they cover, not just the first one.
         for (int i = 0; i < plugin->voices.Length(); i++) {
-            if (Voice *voice = &plugin->voices[i]; (modEvent->key == -1 || voice->key == modEvent->key)
+            if (Voice *voice = &plugin->voices[i]; !voice->stolen && (modEvent->key == -1 || voice->key == modEvent->key)
                                                    && (modEvent->note_id == -1 || voice->noteID == modEvent->note_id)
                                                    && (modEvent->channel == -1 || voice->channel == modEvent->channel)) {
-                voice->parameterOffsets[modEvent->param_id] = modEvent->amount;
-                break;
-                    }
+                PluginSetVoiceModulation(plugin, voice, parameter, modEvent->amount);
+            }
         }
     }
 }
 
+// Apply a parameter value set by the main thread, and tell the host about it.
+static void PluginSendParameterValue(MyPlugin *plugin, const clap_output_events_t *out, uint32_t i) {
+    plugin->parameters[i] = plugin->mainParameters[i];
+    plugin->mainChanged[i] = false;
+
+    clap_event_param_value_t event = {};
+    event.header.size = sizeof(event);
+    event.header.time = 0;
+    event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+    event.header.type = CLAP_EVENT_PARAM_VALUE;
+    event.header.flags = 0;
+    event.param_id = i;
+    event.cookie = nullptr;
+    event.note_id = -1;
+    event.port_index = -1;
+    event.channel = -1;
+    event.key = -1;
+    event.value = plugin->parameters[i];
+    out->try_push(out, &event.header);
+
+    if (i == P_RELEASE || i == P_RETIRE_FLOOR) {
+        plugin->tailChanged = true;
+    }
+
+    if (i == P_TUNING) {
+        PluginUpdateTuning(plugin);
+    }
+}
+
+static void PluginSendGesture(const clap_output_events_t *out, uint32_t i, uint16_t type) {
+    clap_event_param_gesture_t event = {};
+    event.header.size = sizeof(event);
+    event.header.time = 0;
+    event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+    event.header.type = type;
+    event.header.flags = 0;
+    event.param_id = i;
+    out->try_push(out, &event.header);
+}
+
 void PluginSyncMainToAudio(MyPlugin *plugin, const clap_output_events_t *out) {
     MutexAcquire(plugin->syncParameters);
 
-    for (uint32_t i = 0; i < P_COUNT; i++) {
-        if (plugin->gestureStart[i]) {
-            plugin->gestureStart[i] = false;
-
-            clap_event_param_gesture_t event = {};
-            event.header.size = sizeof(event);
-            event.header.time = 0;
-            event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
-            event.header.type = CLAP_EVENT_PARAM_GESTURE_BEGIN;
-            event.header.flags = 0;
-            event.param_id = i;
-            out->try_push(out, &event.header);
-        }
+    if (plugin->renderModeChanged) {
+        plugin->renderMode = plugin->mainRenderMode;
+        plugin->renderPool = plugin->mainRenderPool;
+        plugin->renderModeChanged = false;
+    }
 
-        if (plugin->mainChanged[i]) {
-            plugin->parameters[i] = plugin->mainParameters[i];
-            plugin->mainChanged[i] = false;
-
-            clap_event_param_value_t event = {};
-            event.header.size = sizeof(event);
-            event.header.time = 0;
-            event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
-            event.header.type = CLAP_EVENT_PARAM_VALUE;
-            event.header.flags = 0;
-            event.param_id = i;
-            event.cookie = nullptr;
-            event.note_id = -1;
-            event.port_index = -1;
-            event.channel = -1;
-            event.key = -1;
-            event.value = plugin->parameters[i];
-            out->try_push(out, &event.header);
+    // Swap in the wavetable acquired by the main thread, and hand the old one back for it to release.
+    // If the main thread hasn't released the last one yet, wait until it has.
+    if (plugin->wavetableChanged && !plugin->retiredWavetable) {
+        plugin->retiredWavetable = plugin->wavetable;
+        plugin->wavetable = plugin->mainWavetable;
+        plugin->mainWavetable = nullptr;
+        plugin->wavetableChanged = false;
+
+        if (plugin->retiredWavetable && plugin->host->request_callback) {
+            plugin->host->request_callback(plugin->host);
         }
+    }
 
-        if (plugin->gestureEnd[i]) {
-            plugin->gestureEnd[i] = false;
-
-            clap_event_param_gesture_t event = {};
-            event.header.size = sizeof(event);
-            event.header.time = 0;
-            event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
-            event.header.type = CLAP_EVENT_PARAM_GESTURE_END;
-            event.header.flags = 0;
-            event.param_id = i;
-            out->try_push(out, &event.header);
+    for (uint32_t i = 0; i < P_COUNT; i++) {
+        // Begins and ends always alternate, so replaying them in order only needs their count. A value changed
+        // during a gesture goes out before the gesture ends, even if the main thread has started another since.
+        for (; plugin->gesturesPending[i]; plugin->gesturesPending[i]--) {
+            if (plugin->gestureActive[i] && plugin->mainChanged[i]) PluginSendParameterValue(plugin, out, i);
+            plugin->gestureActive[i] = !plugin->gestureActive[i];
+            PluginSendGesture(out, i, plugin->gestureActive[i] ? CLAP_EVENT_PARAM_GESTURE_BEGIN : CLAP_EVENT_PARAM_GESTURE_END);
         }
+
+        if (plugin->mainChanged[i]) PluginSendParameterValue(plugin, out, i);
     }
 
     MutexRelease(plugin->syncParameters);
@@ -188,28 +563,111 @@ bool PluginSyncAudioToMain(MyPlugin *plugin) {
     MutexRelease(plugin->syncParameters);
     return anyChanged;
 }
+uint32_t PluginTailLength(MyPlugin *plugin) {
+    MutexAcquire(plugin->syncParameters);
+    const float release = plugin->parameters[P_RELEASE];
+    const float floor = plugin->parameters[P_RETIRE_FLOOR];
+    MutexRelease(plugin->syncParameters);
+
+    // The time for a released voice to fall from full level to the floor, where it's retired.
+    // P_RELEASE is the time to fall by 60 dB, and the fall is exponential, so it's linear in decibels.
+    return (uint32_t) ceilf(release * plugin->sampleRate * floor / -60.0f);
+}
+
+// Must be called on the audio thread.
+float PluginEnvelopeFloor(const MyPlugin *plugin) {
+    return powf(10.0f, plugin->parameters[P_RETIRE_FLOOR] / 20.0f);
+}
+
+void PluginUpdateWavetable(MyPlugin *plugin) {
+    MutexAcquire(plugin->syncParameters);
+    const float value = plugin->mainChanged[P_WAVETABLE] ? plugin->mainParameters[P_WAVETABLE] : plugin->parameters[P_WAVETABLE];
+    const Wavetable *retired = plugin->retiredWavetable;
+    plugin->retiredWavetable = nullptr;
+    MutexRelease(plugin->syncParameters);
+
+    WavetableRelease(retired);
+
+    const auto index = static_cast<uint32_t>(std::clamp(value + 0.5f, 0.0f, (float) WavetableCount()));
+    if (index == plugin->mainWavetableIndex) return;
+    plugin->mainWavetableIndex = index;
+
+    // Map the file without holding up the audio thread. If it can't be mapped, fall back to the sine.
+    const Wavetable *wavetable = index ? WavetableAcquire(index - 1) : nullptr;
+
+    MutexAcquire(plugin->syncParameters);
+    const Wavetable *superseded = plugin->wavetableChanged ? plugin->mainWavetable : nullptr;
+    plugin->mainWavetable = wavetable;
+    plugin->wavetableChanged = true;
+    MutexRelease(plugin->syncParameters);
+
+    // The audio thread never saw this one, so it can be released straight away.
+    WavetableRelease(superseded);
+}
+
+void PluginReleaseWavetables(MyPlugin *plugin) {
+    WavetableRelease(plugin->wavetable);
+    WavetableRelease(plugin->mainWavetable);
+    WavetableRelease(plugin->retiredWavetable);
+    plugin->wavetable = plugin->mainWavetable = plugin->retiredWavetable = nullptr;
+    plugin->wavetableChanged = false;
+}
+
+float PluginGUIScale(const MyPlugin *plugin) {
+    return (float) plugin->guiWidth / GUI_WIDTH;
+}
+
+void PluginAdjustGUISize(uint32_t *width, uint32_t *height) {
+    // Keep the aspect ratio exactly, fitting inside the requested size where possible. Sizes are whole multiples of the
+    // smallest size with that ratio, so an adjusted size is left alone if it's adjusted again.
+    constexpr uint32_t unit = std::gcd(GUI_WIDTH, GUI_HEIGHT);
+    constexpr uint32_t unitWidth = GUI_WIDTH / unit, unitHeight = GUI_HEIGHT / unit;
+    const auto minimum = (uint32_t) ceil(GUI_MINIMUM_SCALE * unit), maximum = (uint32_t) (GUI_MAXIMUM_SCALE * unit);
+    const uint32_t multiple = std::clamp(std::min(*width / unitWidth, *height / unitHeight), minimum, maximum);
+    *width = multiple * unitWidth;
+    *height = multiple * unitHeight;
+}
+
+// Convert a coordinate in the GUI_WIDTH x GUI_HEIGHT layout to physical pixels.
+static uint32_t PluginScaleCoordinate(const MyPlugin *plugin, float logical) {
+    return (uint32_t) lroundf(logical * PluginGUIScale(plugin));
+}
+
 void PluginPaintRectangle(MyPlugin *plugin, uint32_t *bits, uint32_t l, uint32_t r, uint32_t t, uint32_t b, uint32_t border, uint32_t fill) {
     for (uint32_t i = t; i < b; i++) {
         for (uint32_t j = l; j < r; j++) {
-            bits[i * GUI_WIDTH + j] = (i == t || i == b - 1 || j == l || j == r - 1) ? border : fill;
+            bits[i * plugin->guiWidth + j] = (i == t || i == b - 1 || j == l || j == r - 1) ? border : fill;
         }
     }
 }
 
-
-void PluginPaint(MyPlugin *plugin, uint32_t *bits) {
+void PluginPaintStatic(MyPlugin *plugin, uint32_t *bits) {
     // Draw the background.
-    PluginPaintRectangle(plugin, bits, 0, GUI_WIDTH, 0, GUI_HEIGHT, 0xC0C0C0, 0xC0C0C0);
+    PluginPaintRectangle(plugin, bits, 0, plugin->guiWidth, 0, plugin->guiHeight, 0xC0C0C0, 0xC0C0C0);
+
+    // Draw the dial's frame.
+    const uint32_t l = PluginScaleCoordinate(plugin, 10), r = PluginScaleCoordinate(plugin, 40);
+    PluginPaintRectangle(plugin, bits, l, r, l, r, 0x000000, 0xC0C0C0);
+}
+
+void PluginPaint(MyPlugin *plugin, uint32_t *bits, const uint32_t *staticBits) {
+    const uint32_t l = PluginScaleCoordinate(plugin, 10), r = PluginScaleCoordinate(plugin, 40);
+
+    // Restore the dial from the static layer, rather than repainting the whole window.
+    for (uint32_t i = l; i < r; i++) {
+        memcpy(bits + i * plugin->guiWidth + l, staticBits + i * plugin->guiWidth + l, (r - l) * sizeof(uint32_t));
+    }
 
     // Draw the parameter, using the parameter value owned by the main thread.
-    PluginPaintRectangle(plugin, bits, 10, 40, 10, 40, 0x000000, 0xC0C0C0);
-    PluginPaintRectangle(plugin, bits, 10, 40, 10 + 30 * (1.0f - plugin->mainParameters[P_VOLUME]), 40, 0x000000, 0x000000);
+    const uint32_t t = PluginScaleCoordinate(plugin, 10 + 30 * (1.0f - plugin->mainParameters[P_VOLUME]));
+    PluginPaintRectangle(plugin, bits, l, r, t, r, 0x000000, 0x000000);
 }
 
 void PluginProcessMouseDrag(MyPlugin *plugin, int32_t x, int32_t y) {
     if (plugin->mouseDragging) {
         // Compute the new value of the parameter based on the mouse's position.
-        const float newValue = FloatClamp01(plugin->mouseDragOriginValue + (plugin->mouseDragOriginY - y) * 0.01f);
+        // Mouse coordinates are in physical pixels, so scale the distance back to the layout's.
+        const float newValue = FloatClamp01(plugin->mouseDragOriginValue + (plugin->mouseDragOriginY - y) * 0.01f / PluginGUIScale(plugin));
 
         // Under the syncParameters mutex, update the main thread's parameters array,
         // and inform the audio thread it should read the value into its array.
@@ -225,9 +683,37 @@ void PluginProcessMouseDrag(MyPlugin *plugin, int32_t x, int32_t y) {
     }
 }
 
+// The timer only runs while the GUI is visible, so a hidden or closed editor costs no main-thread wakeups.
+// Changing the interval means registering a new timer, since the host fixes it at registration.
+void PluginStartTimer(MyPlugin *plugin, uint32_t interval) {
+    if (plugin->timerID != CLAP_INVALID_ID && plugin->timerInterval == interval) return;
+    PluginStopTimer(plugin);
+
+    if (plugin->hostTimerSupport && plugin->hostTimerSupport->register_timer) {
+        if (plugin->hostTimerSupport->register_timer(plugin->host, interval, &plugin->timerID)) {
+            plugin->timerInterval = interval;
+        } else {
+            plugin->timerID = CLAP_INVALID_ID;
+        }
+    }
+}
+
+void PluginStopTimer(MyPlugin *plugin) {
+    if (plugin->timerID != CLAP_INVALID_ID && plugin->hostTimerSupport && plugin->hostTimerSupport->unregister_timer) {
+        plugin->hostTimerSupport->unregister_timer(plugin->host, plugin->timerID);
+    }
+
+    plugin->timerID = CLAP_INVALID_ID;
+}
+
 void PluginProcessMousePress(MyPlugin *plugin, int32_t x, int32_t y) {
+    // A press without a release (say, the window lost capture) doesn't start a second gesture.
+    if (plugin->mouseDragging) return;
+
     // If the cursor is inside the dial...
-    if (x >= 10 && x < 40 && y >= 10 && y < 40) {
+    const int32_t l = PluginScaleCoordinate(plugin, 10), r = PluginScaleCoordinate(plugin, 40);
+
+    if (x >= l && x < r && y >= l && y < r) {
         // Start dragging.
         plugin->mouseDragging = true;
         plugin->mouseDraggingParameter = P_VOLUME;
@@ -235,9 +721,12 @@ void PluginProcessMousePress(MyPlugin *plugin, int32_t x, int32_t y) {
         plugin->mouseDragOriginY = y;
         plugin->mouseDragOriginValue = plugin->mainParameters[P_VOLUME];
 
+        // Run once per frame for as long as the drag lasts.
+        if (plugin->guiVisible) PluginStartTimer(plugin, GUI_FRAME_INTERVAL_MS);
+
         // Inform the audio thread to send a gesture start event.
         MutexAcquire(plugin->syncParameters);
-        plugin->gestureStart[plugin->mouseDraggingParameter] = true;
+        plugin->gesturesPending[plugin->mouseDraggingParameter]++;
         MutexRelease(plugin->syncParameters);
 
         if (plugin->hostParams && plugin->hostParams->request_flush) {
@@ -248,9 +737,15 @@ void PluginProcessMousePress(MyPlugin *plugin, int32_t x, int32_t y) {
 
 void PluginProcessMouseRelease(MyPlugin *plugin) {
     if (plugin->mouseDragging) {
+        // Apply the last queued position before ending the gesture, so the final value isn't lost.
+        if (plugin->mouseDragPending) {
+            plugin->mouseDragPending = false;
+            PluginProcessMouseDrag(plugin, plugin->mouseDragPendingX, plugin->mouseDragPendingY);
+        }
+
         // Inform the audio thread to send a gesture end event.
         MutexAcquire(plugin->syncParameters);
-        plugin->gestureEnd[plugin->mouseDraggingParameter] = true;
+        plugin->gesturesPending[plugin->mouseDraggingParameter]++;
         MutexRelease(plugin->syncParameters);
 
         // As before.
@@ -258,10 +753,48 @@ void PluginProcessMouseRelease(MyPlugin *plugin) {
             plugin->hostParams->request_flush(plugin->host);
         }
 
-        // Dragging has stopped.
+        // Dragging has stopped, so go back to only polling for automation.
         plugin->mouseDragging = false;
+        if (plugin->guiVisible) PluginStartTimer(plugin, GUI_AUTOMATION_INTERVAL_MS);
+    }
+}
+
+bool PluginQueueMouseDrag(MyPlugin *plugin, int32_t x, int32_t y) {
+    if (!plugin->mouseDragging) return false;
+
+    // Without a frame timer there's nothing to coalesce against, so apply the drag immediately.
+    if (plugin->timerID == CLAP_INVALID_ID) {
+        PluginProcessMouseDrag(plugin, x, y);
+        return true;
     }
+
+    // Otherwise only remember the latest position; PluginProcessFrame will apply it once per frame.
+    plugin->mouseDragPending = true;
+    plugin->mouseDragPendingX = x;
+    plugin->mouseDragPendingY = y;
+    return false;
+}
+
+bool PluginProcessFrame(MyPlugin *plugin) {
+    bool repaint = false;
+
+    // At most one parameter push (and so one host flush request) per frame, however many mouse moves arrived.
+    if (plugin->mouseDragPending) {
+        plugin->mouseDragPending = false;
+        PluginProcessMouseDrag(plugin, plugin->mouseDragPendingX, plugin->mouseDragPendingY);
+        repaint = true;
+    }
+
+    // Between drags every tick is already an automation poll. During a drag, automation only needs to be
+    // visible, not immediate, so poll the audio thread's changes less often than we repaint.
+    if (!plugin->mouseDragging || ++plugin->guiFramesSinceAutomation >= GUI_AUTOMATION_FRAME_INTERVAL) {
+        plugin->guiFramesSinceAutomation = 0;
+        if (PluginSyncAudioToMain(plugin)) repaint = true;
+    }
+
+    return repaint;
 }
 
-// Explicitly instantiate the template for Voice
-template class Array<Voice>;
\ No newline at end of file
+// Explicitly instantiate the template for Voice and Modulation
+template class Array<Voice>;
+template class Array<Modulation>;
\ No newline at end of file
@@ -8,10 +8,20 @@
 #include <cstdio>
 #include "parameters.h"
 #include "utils.h"
+#include "wavetable.h"
 
 
+// The GUI is laid out at this size, and scaled uniformly to whatever size the host gives us.
 #define GUI_WIDTH (300)
 #define GUI_HEIGHT (200)
+#define GUI_MINIMUM_SCALE (0.5)
+#define GUI_MAXIMUM_SCALE (4.0)
+
+// While the GUI is visible, it polls for automation every GUI_AUTOMATION_INTERVAL_MS. Only during a drag does the
+// timer run once per frame, and then automation-driven repaints are limited to every Nth frame.
+#define GUI_FRAME_INTERVAL_MS (16)
+#define GUI_AUTOMATION_INTERVAL_MS (200)
+#define GUI_AUTOMATION_FRAME_INTERVAL (4)
 
 template <class T>
 struct Array {
@@ -21,54 +31,161 @@ struct Array {
     void Insert(T newItem, uintptr_t index);
     void Delete(uintptr_t index);
     void Add(T item);
+    void Reserve(size_t count);
+    void Clear();
     void Free();
     [[nodiscard]] int Length() const;
     T &operator[](uintptr_t index);
 };
 
+#define KEY_COUNT (128)
+
+// Voices and polyphonic modulation live in storage allocated on activation, so the audio thread never allocates.
+// A note played with VOICE_MAXIMUM voices sounding steals one, preferring the oldest released voice over the oldest held one.
+// The stolen voice fades out over ENVELOPE_STEAL_SECONDS in one of VOICE_STEAL_HEADROOM extra slots, so it doesn't click.
+// Per-voice modulation is dropped once the pool is full.
+#define VOICE_MAXIMUM (64)
+#define VOICE_STEAL_HEADROOM (16)
+#define VOICE_CAPACITY (VOICE_MAXIMUM + VOICE_STEAL_HEADROOM)
+#define MODULATION_POOL_SIZE (VOICE_CAPACITY * P_MODULATABLE_COUNT)
+
+// Audio is rendered in blocks of at most this many frames, in addition to splitting at each event.
+// Realtime keeps blocks short so modulation ramps stay tight; offline favours throughput.
+#define RENDER_BLOCK_REALTIME (64)
+#define RENDER_BLOCK_OFFLINE (1024)
+
+// Offline rendering spreads voices across worker threads once there are enough of them to be worth it.
+// RENDER_OFFLINE_THREADS of 0 uses one thread per core, 1 disables parallel rendering. The threads are shared by every instance.
+#ifndef RENDER_OFFLINE_THREADS
+#define RENDER_OFFLINE_THREADS (0)
+#endif
+#define RENDER_PARALLEL_MIN_VOICES (8)
+
+#define SINE_TABLE_SIZE (2048)
+
+// Voices fade in over ENVELOPE_ATTACK_SECONDS, and once released, are retired as soon as their envelope falls below P_RETIRE_FLOOR.
+#define ENVELOPE_ATTACK_SECONDS (0.002f)
+#define ENVELOPE_STEAL_SECONDS (0.005f) // To fall by 60 dB.
+
+// Polyphonic modulation is smoothed towards its target with this time constant, applied once per rendered block.
+#define MODULATION_SMOOTHING_SECONDS (0.005f)
+
+// Saved states start with STATE_MAGIC, STATE_VERSION and the number of parameter values that follow, so parameters
+// can be added without older states being misread. After the values comes the wavetable's name, as a length and its bytes.
+#define STATE_MAGIC (0x54534348) // "HCST" when stored little-endian.
+#define STATE_VERSION (1)
+
 struct Voice {
     bool held;
+    bool stolen; // Ended as far as the host knows, and fading out quickly.
     int32_t noteID;
     int16_t channel, key;
     float phase;
-    float parameterOffsets[P_COUNT];
+    float tuning; // From CLAP_NOTE_EXPRESSION_TUNING, in semitones.
+    float increment; // Phase increment per sample, cached from the key table and tuning.
+    float envelope; // Amplitude envelope at the end of the last rendered block.
+    int32_t firstModulation; // Head of this voice's chain in MyPlugin::modulations, or -1.
+};
+
+// One actively modulated (voice, parameter) pair. Entries are chained per voice through next,
+// and unused entries are chained on a free list, so indices stay valid while voices come and go.
+struct Modulation {
+    uint32_t parameter;
+    int32_t next;
+    float target, value;
+};
+
+// Everything a voice needs to render one block, shared by all voices in it.
+struct RenderBlock {
+    uint32_t frames;
+    float smoothing;
+    float attackStep, releaseCoefficient, stealCoefficient;
+    float envelopeFloor;
+    float monophonicStart[P_COUNT], monophonicEnd[P_COUNT];
 };
 
 struct MyPlugin {
     clap_plugin_t plugin;
     const clap_host_t *host;
     float sampleRate;
+    float keyIncrements[KEY_COUNT]; // Equal temperament from P_TUNING, rebuilt by PluginUpdateTuning when it or the sample rate changes.
     Array<Voice> voices;
+    Array<Modulation> modulations;
+    int32_t firstFreeModulation;
+    float modulationTargets[P_COUNT], modulationValues[P_COUNT]; // Monophonic modulation, applied to every voice.
     float parameters[P_COUNT], mainParameters[P_COUNT];
     bool changed[P_COUNT], mainChanged[P_COUNT];
     Mutex syncParameters;
+    const Wavetable *wavetable; // Used by the audio thread; nullptr is the built-in sine.
+    const Wavetable *mainWavetable; // Acquired by the main thread, waiting for the audio thread to pick it up.
+    const Wavetable *retiredWavetable; // Dropped by the audio thread, waiting for the main thread to release it.
+    bool wavetableChanged;
+    uint32_t mainWavetableIndex;
+    clap_plugin_render_mode renderMode, mainRenderMode;
+    bool renderModeChanged;
+    struct RenderPool *renderPool; // Used by the audio thread while rendering offline.
+    struct RenderPool *mainRenderPool; // The reference the main thread holds, acquired once the mode is offline.
     struct GUI *gui;
+    uint32_t guiWidth, guiHeight; // In physical pixels, always GUI_WIDTH:GUI_HEIGHT.
+    bool guiVisible; // Between show and hide, which is when the timer should be running.
     const clap_host_posix_fd_support_t *hostPOSIXFDSupport;
     const clap_host_params_t *hostParams;
-    bool gestureStart[P_COUNT], gestureEnd[P_COUNT];
+    const clap_host_tail_t *hostTail;
+    bool tailChanged; // Reported by process(), since the host must hear about it on the audio thread, and not under syncParameters.
+    uint32_t gesturesPending[P_COUNT]; // Begins and ends from the main thread, alternating from the opposite of gestureActive.
+    bool gestureActive[P_COUNT]; // As sent to the host.
     bool mouseDragging;
     uint32_t mouseDraggingParameter;
     int32_t mouseDragOriginX, mouseDragOriginY;
     float mouseDragOriginValue;
+    bool mouseDragPending;
+    int32_t mouseDragPendingX, mouseDragPendingY;
+    uint32_t guiFramesSinceAutomation;
     const clap_host_timer_support_t *hostTimerSupport;
     clap_id timerID;
+    uint32_t timerInterval;
 };
 
 extern const clap_plugin_descriptor_t pluginDescriptor;
 void PluginRenderAudio(MyPlugin *plugin, uint32_t start, uint32_t end, float *outputL, float *outputR);
-void PluginProcessEvent(MyPlugin *plugin, const clap_event_header_t *event);
+void PluginRenderVoice(MyPlugin *plugin, Voice *voice, const RenderBlock *block, float *output);
+void PluginProcessEvent(MyPlugin *plugin, const clap_event_header_t *event, const clap_output_events_t *out);
+void PluginSendNoteEnd(const clap_output_events_t *out, const Voice *voice);
+void PluginUpdateTuning(MyPlugin *plugin);
+void PluginDeleteVoice(MyPlugin *plugin, uintptr_t index);
+void PluginPruneModulations(MyPlugin *plugin);
+void PluginResetModulations(MyPlugin *plugin);
+void PluginFreeModulations(MyPlugin *plugin);
 void PluginSyncMainToAudio(MyPlugin *plugin, const clap_output_events_t *out);
 bool PluginSyncAudioToMain(MyPlugin *plugin);
-void PluginPaint(MyPlugin *plugin, uint32_t *bits);
+uint32_t PluginTailLength(MyPlugin *plugin);
+float PluginEnvelopeFloor(const MyPlugin *plugin);
+void PluginUpdateWavetable(MyPlugin *plugin);
+void PluginReleaseWavetables(MyPlugin *plugin);
+float PluginGUIScale(const MyPlugin *plugin);
+void PluginAdjustGUISize(uint32_t *width, uint32_t *height);
+void PluginPaintStatic(MyPlugin *plugin, uint32_t *bits);
+void PluginPaint(MyPlugin *plugin, uint32_t *bits, const uint32_t *staticBits);
 void PluginProcessMousePress(MyPlugin *plugin, int x, int y);
 void PluginProcessMouseDrag(MyPlugin *plugin, int x, int y);
 void PluginProcessMouseRelease(MyPlugin *plugin);
+bool PluginQueueMouseDrag(MyPlugin *plugin, int x, int y);
+bool PluginProcessFrame(MyPlugin *plugin);
+void PluginStartTimer(MyPlugin *plugin, uint32_t interval);
+void PluginStopTimer(MyPlugin *plugin);
 void PluginPaintRectangle(MyPlugin *plugin, uint32_t *bits, uint32_t l, uint32_t r, uint32_t t, uint32_t b, uint32_t border, uint32_t fill);
 
+// Acquire and release must be called on the main thread. Acquire returns nullptr when there's only one core to render on.
+// Render returns false, having left the output untouched, if another instance is rendering with the pool.
+struct RenderPool *RenderPoolAcquire();
+void RenderPoolRelease(struct RenderPool *pool);
+bool RenderPoolRender(MyPlugin *plugin, const RenderBlock *block, float *output);
+
 void GUICreate(MyPlugin* plugin);
 void GUIDestroy(MyPlugin* plugin);
 void GUISetParent(const MyPlugin* plugin, const clap_window_t* window);
 void GUISetVisible(const MyPlugin* plugin, bool visible);
 void GUIOnPOSIXFD(MyPlugin* plugin);
 void GUIPaint(MyPlugin* plugin, bool internal);
+void GUIResize(MyPlugin* plugin);
 
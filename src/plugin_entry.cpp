@@ -50,6 +50,43 @@ static constexpr clap_plugin_params_t extensionParams = {
             information->default_value = 0.5f;
             strcpy(information->name, "Volume");
             return true;
+        } else if (index == P_WAVETABLE) {
+            memset(information, 0, sizeof(clap_param_info_t));
+            information->id = index;
+            information->flags = CLAP_PARAM_IS_AUTOMATABLE | CLAP_PARAM_IS_STEPPED;
+            information->min_value = 0.0f;
+            information->max_value = WavetableCount();
+            information->default_value = 0.0f;
+            strcpy(information->name, "Wavetable");
+            return true;
+        } else if (index == P_RELEASE) {
+            memset(information, 0, sizeof(clap_param_info_t));
+            information->id = index;
+            information->flags = CLAP_PARAM_IS_AUTOMATABLE;
+            information->min_value = 0.01f;
+            information->max_value = 10.0f;
+            information->default_value = 0.3f;
+            strcpy(information->name, "Release");
+            return true;
+        } else if (index == P_RETIRE_FLOOR) {
+            memset(information, 0, sizeof(clap_param_info_t));
+            information->id = index;
+            // A setting rather than part of the sound, so it's saved with the state but not automated.
+            information->flags = 0;
+            information->min_value = -120.0f;
+            information->max_value = -40.0f;
+            information->default_value = -80.0f;
+            strcpy(information->name, "Release Floor");
+            return true;
+        } else if (index == P_TUNING) {
+            memset(information, 0, sizeof(clap_param_info_t));
+            information->id = index;
+            information->flags = CLAP_PARAM_IS_AUTOMATABLE;
+            information->min_value = 400.0f;
+            information->max_value = 480.0f;
+            information->default_value = 440.0f;
+            strcpy(information->name, "Tuning");
+            return true;
         } else {
             return false;
         }
@@ -72,8 +109,16 @@ static constexpr clap_plugin_params_t extensionParams = {
     },
 
     .value_to_text = [] (const clap_plugin_t *_plugin, const clap_id id, const double value, char *display, const uint32_t size) {
-        if (const auto i = static_cast<uint32_t>(id); i >= P_COUNT) return false;
-        snprintf(display, size, "%f", value);
+        const auto i = static_cast<uint32_t>(id);
+        if (i >= P_COUNT) return false;
+
+        if (i == P_WAVETABLE) {
+            const auto index = static_cast<uint32_t>(value + 0.5);
+            snprintf(display, size, "%s", index && WavetableName(index - 1) ? WavetableName(index - 1) : "Sine");
+        } else {
+            snprintf(display, size, "%f", value);
+        }
+
         return true;
     },
 
@@ -91,11 +136,37 @@ static constexpr clap_plugin_params_t extensionParams = {
 
         // Process events sent to our plugin from the host.
         for (uint32_t eventIndex = 0; eventIndex < eventCount; eventIndex++) {
-            PluginProcessEvent(plugin, in->get(in, eventIndex));
+            PluginProcessEvent(plugin, in->get(in, eventIndex), out);
         }
     },
 };
 
+// CLAP streams may transfer fewer bytes than asked for, so keep going until everything is done or the stream ends.
+static int64_t StreamRead(const clap_istream_t *stream, void *buffer, uint64_t size) {
+    uint64_t position = 0;
+
+    while (position < size) {
+        const int64_t read = stream->read(stream, static_cast<char *>(buffer) + position, size - position);
+        if (read < 0) return read;
+        if (read == 0) break;
+        position += read;
+    }
+
+    return (int64_t) position;
+}
+
+static bool StreamWrite(const clap_ostream_t *stream, const void *buffer, uint64_t size) {
+    uint64_t position = 0;
+
+    while (position < size) {
+        const int64_t written = stream->write(stream, static_cast<const char *>(buffer) + position, size - position);
+        if (written <= 0) return false;
+        position += written;
+    }
+
+    return true;
+}
+
 static constexpr clap_plugin_state_t extensionState = {
     .save = [] (const clap_plugin_t *_plugin, const clap_ostream_t *stream) -> bool {
         auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
@@ -104,20 +175,77 @@ static constexpr clap_plugin_state_t extensionState = {
         // before we save the state of the plugin.
         PluginSyncAudioToMain(plugin);
 
-        return sizeof(float) * P_COUNT == stream->write(stream, plugin->mainParameters, sizeof(float) * P_COUNT);
+        // The wavetable is also saved by name, so the state still refers to the same one if the library changes.
+        const auto index = static_cast<uint32_t>(plugin->mainParameters[P_WAVETABLE] + 0.5f);
+        const char *name = index ? WavetableName(index - 1) : nullptr;
+        const uint32_t nameLength = name ? strlen(name) : 0;
+
+        const uint32_t header[] = { STATE_MAGIC, STATE_VERSION, P_COUNT };
+
+        return StreamWrite(stream, header, sizeof(header))
+            && StreamWrite(stream, plugin->mainParameters, sizeof(float) * P_COUNT)
+            && StreamWrite(stream, &nameLength, sizeof(nameLength))
+            && StreamWrite(stream, name, nameLength);
     },
 
     .load = [] (const clap_plugin_t *_plugin, const clap_istream_t *stream) -> bool {
         auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
 
+        // Anything the state doesn't have keeps its default.
+        float parameters[P_COUNT];
+        clap_param_info_t information[P_COUNT] = {};
+
+        for (uint32_t i = 0; i < P_COUNT; i++) {
+            extensionParams.get_info(_plugin, i, &information[i]);
+            parameters[i] = information[i].default_value;
+        }
+
+        uint32_t header[3];
+        char name[256] = {};
+        if (StreamRead(stream, header, sizeof(header[0])) != sizeof(header[0])) return false;
+
+        if (header[0] == STATE_MAGIC) {
+            if (StreamRead(stream, header + 1, sizeof(header) - sizeof(header[0])) != sizeof(header) - sizeof(header[0])) return false;
+            if (header[1] > STATE_VERSION) return false;
+
+            // Values for parameters this version doesn't have are skipped.
+            for (uint32_t i = 0; i < header[2]; i++) {
+                float value;
+                if (StreamRead(stream, &value, sizeof(value)) != sizeof(value)) return false;
+                if (i < P_COUNT) parameters[i] = value;
+            }
+
+            uint32_t nameLength;
+            if (StreamRead(stream, &nameLength, sizeof(nameLength)) != sizeof(nameLength)) return false;
+            if (nameLength >= sizeof(name) || StreamRead(stream, name, nameLength) != nameLength) return false;
+        } else {
+            // States saved before STATE_MAGIC was added are just the volume, so there must be nothing after it.
+            uint8_t extra;
+            if (StreamRead(stream, &extra, sizeof(extra)) != 0) return false;
+            memcpy(&parameters[P_VOLUME], &header[0], sizeof(float));
+        }
+
+        // A wavetable that's no longer in the library falls back to the sine.
+        if (name[0]) {
+            uint32_t index;
+            parameters[P_WAVETABLE] = WavetableFind(name, &index) ? index + 1 : 0;
+        }
+
+        // The state may come from anywhere, so keep every value within its parameter's range.
+        for (uint32_t i = 0; i < P_COUNT; i++) {
+            parameters[i] = std::isfinite(parameters[i]) ? std::clamp<float>(parameters[i], information[i].min_value, information[i].max_value)
+                                                        : information[i].default_value;
+        }
+
         // Since we're modifying a parameter array, we need to acquire the syncParameters mutex.
         MutexAcquire(plugin->syncParameters);
-        const bool success = sizeof(float) * P_COUNT == stream->read(stream, plugin->mainParameters, sizeof(float) * P_COUNT);
+        memcpy(plugin->mainParameters, parameters, sizeof(parameters));
         // Make sure that the audio thread will pick up upon the modified parameters next time pluginClass.process is called.
         for (bool & i : plugin->mainChanged) i = true;
         MutexRelease(plugin->syncParameters);
 
-        return success;
+        PluginUpdateWavetable(plugin);
+        return true;
     },
 };
 
@@ -139,32 +267,59 @@ static constexpr clap_plugin_gui_t extensionGUI = {
     },
 
     .destroy = [] (const clap_plugin_t *_plugin) {
-        GUIDestroy(static_cast<MyPlugin *>(_plugin->plugin_data));
+        auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
+        plugin->guiVisible = false;
+        PluginStopTimer(plugin);
+        GUIDestroy(plugin);
     },
 
-    .set_scale = [] (const clap_plugin_t *plugin, double scale) -> bool {
-        return false;
+    .set_scale = [] (const clap_plugin_t *_plugin, double scale) -> bool {
+        // Win32 works in physical pixels, so the host's scale becomes our size; the host then asks for it with get_size.
+        if (scale <= 0.0) return false;
+        uint32_t width = (uint32_t) lround(GUI_WIDTH * scale), height = (uint32_t) lround(GUI_HEIGHT * scale);
+        PluginAdjustGUISize(&width, &height);
+        return extensionGUI.set_size(_plugin, width, height);
     },
 
-    .get_size = [] (const clap_plugin_t *plugin, uint32_t *width, uint32_t *height) -> bool {
-        *width = GUI_WIDTH;
-        *height = GUI_HEIGHT;
+    .get_size = [] (const clap_plugin_t *_plugin, uint32_t *width, uint32_t *height) -> bool {
+        const auto *plugin = static_cast<const MyPlugin *>(_plugin->plugin_data);
+        *width = plugin->guiWidth;
+        *height = plugin->guiHeight;
         return true;
     },
 
     .can_resize = [] (const clap_plugin_t *plugin) -> bool {
-        return false;
+        return true;
     },
 
     .get_resize_hints = [] (const clap_plugin_t *plugin, clap_gui_resize_hints_t *hints) -> bool {
-        return false;
+        hints->can_resize_horizontally = true;
+        hints->can_resize_vertically = true;
+        hints->preserve_aspect_ratio = true;
+        hints->aspect_ratio_width = GUI_WIDTH;
+        hints->aspect_ratio_height = GUI_HEIGHT;
+        return true;
     },
 
     .adjust_size = [] (const clap_plugin_t *plugin, uint32_t *width, uint32_t *height) -> bool {
-        return extensionGUI.get_size(plugin, width, height);
+        PluginAdjustGUISize(width, height);
+        return true;
     },
 
-    .set_size = [] (const clap_plugin_t *plugin, uint32_t width, uint32_t height) -> bool {
+    .set_size = [] (const clap_plugin_t *_plugin, uint32_t width, uint32_t height) -> bool {
+        auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
+
+        // Only sizes that adjust_size would leave alone are accepted. The host is expected to adjust the size first.
+        uint32_t adjustedWidth = width, adjustedHeight = height;
+        PluginAdjustGUISize(&adjustedWidth, &adjustedHeight);
+        if (adjustedWidth != width || adjustedHeight != height) return false;
+        if (width == plugin->guiWidth && height == plugin->guiHeight) return true;
+
+        plugin->guiWidth = width;
+        plugin->guiHeight = height;
+
+        // The static layers are only rasterized again when the size actually changes.
+        if (plugin->gui) GUIResize(plugin);
         return true;
     },
 
@@ -182,12 +337,21 @@ static constexpr clap_plugin_gui_t extensionGUI = {
     },
 
     .show = [] (const clap_plugin_t *_plugin) -> bool {
-        GUISetVisible(static_cast<MyPlugin *>(_plugin->plugin_data), true);
+        auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
+        GUISetVisible(plugin, true);
+        plugin->guiVisible = true;
+        PluginStartTimer(plugin, GUI_AUTOMATION_INTERVAL_MS);
+
+        // Pick up anything that changed while we were hidden.
+        if (PluginSyncAudioToMain(plugin)) GUIPaint(plugin, true);
         return true;
     },
 
     .hide = [] (const clap_plugin_t *_plugin) -> bool {
-        GUISetVisible(static_cast<MyPlugin *>(_plugin->plugin_data), false);
+        auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
+        plugin->guiVisible = false;
+        PluginStopTimer(plugin);
+        GUISetVisible(plugin, false);
         return true;
     },
 };
@@ -201,14 +365,42 @@ static constexpr clap_plugin_posix_fd_support_t extensionPOSIXFDSupport = {
 
 static constexpr clap_plugin_timer_support_t extensionTimerSupport = {
     .on_timer = [] (const clap_plugin_t *_plugin, clap_id timerID) {
-        // If the GUI is open and at least one parameter value has changed...
-        if (auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data); plugin->gui && PluginSyncAudioToMain(plugin)) {
-            // Repaint the GUI.
+        // If the GUI is open and this frame has something new to show...
+        if (auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data); plugin->gui && PluginProcessFrame(plugin)) {
+            // Repaint the GUI, once for everything that happened since the last frame.
             GUIPaint(plugin, true);
         }
     },
 };
 
+static constexpr clap_plugin_render_t extensionRender = {
+    .has_hard_realtime_requirement = [] (const clap_plugin_t *plugin) -> bool {
+        return false;
+    },
+
+    .set = [] (const clap_plugin_t *_plugin, clap_plugin_render_mode mode) -> bool {
+        auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
+        if (mode != CLAP_RENDER_REALTIME && mode != CLAP_RENDER_OFFLINE) return false;
+
+        // Starting threads can take a while, so it's done here rather than in process(). The reference is kept until
+        // deactivation even if the mode goes back to realtime, so the audio thread never sees the pool go away.
+        RenderPool *pool = mode == CLAP_RENDER_OFFLINE && !plugin->mainRenderPool ? RenderPoolAcquire() : nullptr;
+
+        // The audio thread picks up the new mode and pool in PluginSyncMainToAudio, at the start of its next block.
+        MutexAcquire(plugin->syncParameters);
+        if (pool) plugin->mainRenderPool = pool;
+        plugin->mainRenderMode = mode;
+        plugin->renderModeChanged = true;
+        MutexRelease(plugin->syncParameters);
+        return true;
+    },
+};
+
+static constexpr clap_plugin_tail_t extensionTail = {
+    .get = [] (const clap_plugin_t *_plugin) -> uint32_t {
+        return PluginTailLength(static_cast<MyPlugin *>(_plugin->plugin_data));
+    },
+};
 
 static clap_plugin_t pluginClass = {
     .desc = &pluginDescriptor,
@@ -219,8 +411,12 @@ static clap_plugin_t pluginClass = {
 
         plugin->hostPOSIXFDSupport = static_cast<const clap_host_posix_fd_support_t *>(plugin->host->get_extension(plugin->host, CLAP_EXT_POSIX_FD_SUPPORT));
         MutexInitialise(plugin->syncParameters);
+        plugin->firstFreeModulation = -1;
 
         plugin->hostParams = static_cast<const clap_host_params_t *>(plugin->host->get_extension(plugin->host, CLAP_EXT_PARAMS));
+        plugin->hostTail = static_cast<const clap_host_tail_t *>(plugin->host->get_extension(plugin->host, CLAP_EXT_TAIL));
+        plugin->guiWidth = GUI_WIDTH;
+        plugin->guiHeight = GUI_HEIGHT;
 
         for (uint32_t i = 0; i < P_COUNT; i++) {
             clap_param_info_t information = {};
@@ -228,21 +424,20 @@ static clap_plugin_t pluginClass = {
             plugin->mainParameters[i] = plugin->parameters[i] = information.default_value;
         }
 
+        // The timer is registered when the GUI is shown, see PluginStartTimer.
         plugin->hostTimerSupport = static_cast<const clap_host_timer_support_t *>(plugin->host->get_extension(plugin->host, CLAP_EXT_TIMER_SUPPORT));
-
-        if (plugin->hostTimerSupport && plugin->hostTimerSupport->register_timer) {
-            plugin->hostTimerSupport->register_timer(plugin->host, 200 /* every 200 milliseconds */, &plugin->timerID);
-        }
+        plugin->timerID = CLAP_INVALID_ID;
 
         return true;
     },
 
     .destroy = [] (const clap_plugin *_plugin) {
         auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
+        RenderPoolRelease(plugin->mainRenderPool);
+        PluginReleaseWavetables(plugin);
         plugin->voices.Free();
-        if (plugin->hostTimerSupport && plugin->hostTimerSupport->register_timer) {
-            plugin->hostTimerSupport->unregister_timer(plugin->host, plugin->timerID);
-        }
+        PluginFreeModulations(plugin);
+        PluginStopTimer(plugin);
         MutexDestroy(plugin->syncParameters);
         free(plugin);
     },
@@ -250,10 +445,25 @@ static clap_plugin_t pluginClass = {
     .activate = [] (const clap_plugin *_plugin, const double sampleRate, uint32_t minimumFramesCount, uint32_t maximumFramesCount) -> bool {
         auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
         plugin->sampleRate = sampleRate;
+        PluginUpdateTuning(plugin);
+
+        // Everything the audio thread adds to is allocated up front, see VOICE_MAXIMUM.
+        plugin->voices.Reserve(VOICE_CAPACITY);
+        PluginResetModulations(plugin);
+
+        // The audio thread isn't running yet, so it can be handed the pool directly.
+        if (plugin->mainRenderMode == CLAP_RENDER_OFFLINE && !plugin->mainRenderPool) {
+            plugin->mainRenderPool = RenderPoolAcquire();
+        }
+
+        plugin->renderPool = plugin->mainRenderPool;
         return true;
     },
 
     .deactivate = [] (const clap_plugin *_plugin) {
+        auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
+        RenderPoolRelease(plugin->mainRenderPool);
+        plugin->mainRenderPool = plugin->renderPool = nullptr;
     },
 
     .start_processing = [] (const clap_plugin *_plugin) -> bool {
@@ -265,7 +475,13 @@ static clap_plugin_t pluginClass = {
 
     .reset = [] (const clap_plugin *_plugin) {
         auto *plugin = static_cast<MyPlugin *>(_plugin->plugin_data);
-        plugin->voices.Free();
+        plugin->voices.Clear();
+        PluginResetModulations(plugin);
+
+        // The host's modulation still stands, only the smoothing towards it is reset.
+        for (uint32_t i = 0; i < P_COUNT; i++) {
+            plugin->modulationValues[i] = plugin->modulationTargets[i];
+        }
     },
 
     .process = [] (const clap_plugin *_plugin, const clap_process_t *process) -> clap_process_status {
@@ -277,6 +493,9 @@ static clap_plugin_t pluginClass = {
         assert(process->audio_outputs_count == 1);
         assert(process->audio_inputs_count == 0);
 
+        const bool offline = plugin->renderMode == CLAP_RENDER_OFFLINE;
+        const uint32_t blockSize = offline ? RENDER_BLOCK_OFFLINE : RENDER_BLOCK_REALTIME;
+
         const uint32_t frameCount = process->frames_count;
         const uint32_t inputEventCount = process->in_events->size(process->in_events);
         uint32_t eventIndex = 0;
@@ -291,7 +510,7 @@ static clap_plugin_t pluginClass = {
                     break;
                 }
 
-                PluginProcessEvent(plugin, event);
+                PluginProcessEvent(plugin, event, process->out_events);
                 eventIndex++;
 
                 if (eventIndex == inputEventCount) {
@@ -300,29 +519,32 @@ static clap_plugin_t pluginClass = {
                 }
             }
 
-            PluginRenderAudio(plugin, i, nextEventFrame, process->audio_outputs[0].data32[0], process->audio_outputs[0].data32[1]);
-            i = nextEventFrame;
+            const uint32_t blockEnd = std::min(nextEventFrame, i + blockSize);
+            PluginRenderAudio(plugin, i, blockEnd, process->audio_outputs[0].data32[0], process->audio_outputs[0].data32[1]);
+            i = blockEnd;
         }
 
+        const float envelopeFloor = PluginEnvelopeFloor(plugin);
+
         for (int i = 0; i < plugin->voices.Length(); i++) {
-            if (const Voice *voice = &plugin->voices[i]; !voice->held) {
-                clap_event_note_t event = {};
-                event.header.size = sizeof(event);
-                event.header.time = 0;
-                event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
-                event.header.type = CLAP_EVENT_NOTE_END;
-                event.header.flags = 0;
-                event.key = voice->key;
-                event.note_id = voice->noteID;
-                event.channel = voice->channel;
-                event.port_index = 0;
-                process->out_events->try_push(process->out_events, &event.header);
-
-                plugin->voices.Delete(i--);
+            // Released voices are retired once their envelope has decayed below the floor.
+            // Stolen voices already sent their NOTE_END when they were stolen.
+            if (const Voice *voice = &plugin->voices[i]; !voice->held && voice->envelope < envelopeFloor) {
+                if (!voice->stolen) PluginSendNoteEnd(process->out_events, voice);
+                PluginDeleteVoice(plugin, i--);
             }
         }
 
-        return CLAP_PROCESS_CONTINUE;
+        PluginPruneModulations(plugin);
+
+        // Only now is syncParameters certain not to be held, so tell the host about any change to the tail.
+        if (plugin->tailChanged) {
+            plugin->tailChanged = false;
+            if (plugin->hostTail && plugin->hostTail->changed) plugin->hostTail->changed(plugin->host);
+        }
+
+        // With no voices left, the host can stop calling process() until the next event.
+        return plugin->voices.Length() ? CLAP_PROCESS_CONTINUE : CLAP_PROCESS_SLEEP;
     },
 
     .get_extension = [] (const clap_plugin *plugin, const char *id) -> const void * {
@@ -334,10 +556,14 @@ static clap_plugin_t pluginClass = {
         if (0 == strcmp(id, CLAP_EXT_POSIX_FD_SUPPORT)) return &extensionPOSIXFDSupport;
         if (0 == strcmp(id, CLAP_EXT_TIMER_SUPPORT   )) return &extensionTimerSupport;
         if (0 == strcmp(id, CLAP_EXT_STATE           )) return &extensionState;
+        if (0 == strcmp(id, CLAP_EXT_RENDER          )) return &extensionRender;
+        if (0 == strcmp(id, CLAP_EXT_TAIL            )) return &extensionTail;
         return nullptr;
     },
 
     .on_main_thread = [] (const clap_plugin *_plugin) {
+        // Requested by the audio thread when the wavetable parameter changes, or when it retires a wavetable.
+        PluginUpdateWavetable(static_cast<MyPlugin *>(_plugin->plugin_data));
     },
 };
 
@@ -369,10 +595,13 @@ extern "C" const clap_plugin_entry_t clap_entry = {
     .clap_version = CLAP_VERSION_INIT,
 
     .init = [] (const char *path) -> bool {
+        WavetableLibraryInitialise(path);
         return true;
     },
 
-    .deinit = [] () {},
+    .deinit = [] () {
+        WavetableLibraryDeinitialise();
+    },
 
     .get_factory = [] (const char *factoryID) -> const void * {
         return strcmp(factoryID, CLAP_PLUGIN_FACTORY_ID) ? nullptr : &pluginFactory;
@@ -0,0 +1,136 @@
+#include "plugin.h"
+#include <thread>
+#include <condition_variable>
+
+// Worker threads used to render voices in parallel during offline rendering.
+// There's one pool for the whole process, shared by every instance that is set to render offline, so the number of
+// threads doesn't grow with the number of instances. It renders one instance's block at a time: each worker renders
+// every (threadCount + 1)th voice into its own scratch buffer, the calling audio thread takes the rest, and the
+// scratch buffers are summed into the output once everyone is done.
+struct RenderPool {
+    std::thread *threads;
+    uint32_t threadCount;
+    float (*scratch)[RENDER_BLOCK_OFFLINE];
+    uint32_t references; // Guarded by sharedPoolMutex.
+
+    std::mutex busy; // Held by the audio thread whose block is being rendered.
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    uint64_t generation;
+    uint32_t remaining;
+    bool quit;
+    MyPlugin *plugin;
+    const RenderBlock *block;
+};
+
+static RenderPool *sharedPool;
+static std::mutex sharedPoolMutex;
+
+static void RenderPoolRenderShare(RenderPool *pool, MyPlugin *plugin, const RenderBlock *block, uint32_t share, float *output) {
+    for (int i = share; i < plugin->voices.Length(); i += pool->threadCount + 1) {
+        PluginRenderVoice(plugin, &plugin->voices[i], block, output);
+    }
+}
+
+static void RenderPoolWorker(RenderPool *pool, uint32_t worker) {
+    uint64_t generation = 0;
+
+    while (true) {
+        std::unique_lock lock(pool->mutex);
+        pool->wake.wait(lock, [&] { return pool->quit || pool->generation != generation; });
+        if (pool->quit) return;
+        generation = pool->generation;
+        MyPlugin *plugin = pool->plugin;
+        const RenderBlock *block = pool->block;
+        lock.unlock();
+
+        float *output = pool->scratch[worker];
+        memset(output, 0, block->frames * sizeof(float));
+        RenderPoolRenderShare(pool, plugin, block, worker + 1, output);
+
+        lock.lock();
+        if (--pool->remaining == 0) pool->done.notify_one();
+    }
+}
+
+RenderPool *RenderPoolAcquire() {
+    std::lock_guard lock(sharedPoolMutex);
+
+    if (!sharedPool) {
+        uint32_t threadCount = RENDER_OFFLINE_THREADS ? RENDER_OFFLINE_THREADS : std::thread::hardware_concurrency();
+        if (threadCount <= 1) return nullptr; // The audio thread alone is already a single-threaded render.
+        threadCount--;
+
+        auto *pool = new RenderPool{};
+        pool->threadCount = threadCount;
+        pool->scratch = new float[threadCount][RENDER_BLOCK_OFFLINE];
+        pool->threads = new std::thread[threadCount];
+
+        for (uint32_t i = 0; i < threadCount; i++) {
+            pool->threads[i] = std::thread(RenderPoolWorker, pool, i);
+        }
+
+        sharedPool = pool;
+    }
+
+    sharedPool->references++;
+    return sharedPool;
+}
+
+void RenderPoolRelease(RenderPool *pool) {
+    if (!pool) return;
+
+    std::lock_guard lock(sharedPoolMutex);
+    assert(pool == sharedPool && pool->references);
+    if (--pool->references) return;
+
+    {
+        std::lock_guard poolLock(pool->mutex);
+        pool->quit = true;
+    }
+
+    pool->wake.notify_all();
+
+    for (uint32_t i = 0; i < pool->threadCount; i++) {
+        pool->threads[i].join();
+    }
+
+    delete[] pool->threads;
+    delete[] pool->scratch;
+    delete pool;
+    sharedPool = nullptr;
+}
+
+bool RenderPoolRender(MyPlugin *plugin, const RenderBlock *block, float *output) {
+    RenderPool *pool = plugin->renderPool;
+    assert(block->frames <= RENDER_BLOCK_OFFLINE);
+
+    // Another instance is using the pool, so rather than wait for it, this block is rendered on the calling thread.
+    std::unique_lock busy(pool->busy, std::try_to_lock);
+    if (!busy.owns_lock()) return false;
+
+    {
+        std::lock_guard lock(pool->mutex);
+        pool->plugin = plugin;
+        pool->block = block;
+        pool->remaining = pool->threadCount;
+        pool->generation++;
+    }
+
+    pool->wake.notify_all();
+
+    RenderPoolRenderShare(pool, plugin, block, 0, output);
+
+    {
+        std::unique_lock lock(pool->mutex);
+        pool->done.wait(lock, [&] { return pool->remaining == 0; });
+    }
+
+    for (uint32_t worker = 0; worker < pool->threadCount; worker++) {
+        for (uint32_t index = 0; index < block->frames; index++) {
+            output[index] += pool->scratch[worker][index];
+        }
+    }
+
+    return true;
+}
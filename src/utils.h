@@ -3,11 +3,56 @@
 #include <mutex>
 #include <algorithm>
 
+#ifdef PLUGIN_SYNC_STATS
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Records how long threads wait for the mutex and how long they hold it, and reports it when the mutex is destroyed.
+// The counters are only touched while the mutex is held, so they need no synchronization of their own.
+// (std::max) is parenthesized so it still compiles after a <windows.h> included without NOMINMAX.
+struct Mutex {
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point acquired;
+    uint64_t acquisitions, waitNanoseconds, holdNanoseconds, maximumWaitNanoseconds, maximumHoldNanoseconds;
+};
+
+static inline void MutexAcquireTimed(Mutex &mutex) {
+    const auto start = std::chrono::steady_clock::now();
+    mutex.mutex.lock();
+    mutex.acquired = std::chrono::steady_clock::now();
+    const uint64_t wait = std::chrono::duration_cast<std::chrono::nanoseconds>(mutex.acquired - start).count();
+    mutex.acquisitions++;
+    mutex.waitNanoseconds += wait;
+    mutex.maximumWaitNanoseconds = (std::max)(mutex.maximumWaitNanoseconds, wait);
+}
+
+static inline void MutexReleaseTimed(Mutex &mutex) {
+    const uint64_t hold = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mutex.acquired).count();
+    mutex.holdNanoseconds += hold;
+    mutex.maximumHoldNanoseconds = (std::max)(mutex.maximumHoldNanoseconds, hold);
+    mutex.mutex.unlock();
+}
+
+static inline void MutexReport(const Mutex &mutex, const char *name) {
+    if (!mutex.acquisitions) return;
+    fprintf(stderr, "%s: %llu acquisitions, wait %.0f ns mean / %llu ns max, hold %.0f ns mean / %llu ns max\n", name,
+            (unsigned long long) mutex.acquisitions,
+            (double) mutex.waitNanoseconds / mutex.acquisitions, (unsigned long long) mutex.maximumWaitNanoseconds,
+            (double) mutex.holdNanoseconds / mutex.acquisitions, (unsigned long long) mutex.maximumHoldNanoseconds);
+}
+
+#define MutexAcquire(mutex) MutexAcquireTimed(mutex)
+#define MutexRelease(mutex) MutexReleaseTimed(mutex)
+#define MutexInitialise(mutex)
+#define MutexDestroy(mutex) MutexReport(mutex, #mutex)
+#else
 using Mutex = std::mutex;
 #define MutexAcquire(mutex) (mutex).lock()
 #define MutexRelease(mutex) (mutex).unlock()
 #define MutexInitialise(mutex)
 #define MutexDestroy(mutex)
+#endif
 
 static float FloatClamp01(float x) {
     return std::clamp(x, 0.0f, 1.0f);
@@ -0,0 +1,202 @@
+#include "wavetable.h"
+#include "utils.h"
+#include <cstring>
+#include <cassert>
+#include <string>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+struct WavetableEntry {
+    std::filesystem::path path;
+    std::string name;
+    uint32_t references;
+    Wavetable wavetable;
+    const void *view;
+    size_t size;
+};
+
+// The library is scanned once when the plugin binary is loaded, so indices are stable for the life of the process.
+static WavetableEntry libraryEntries[WAVETABLE_MAX_COUNT];
+static uint32_t libraryCount = 0;
+static Mutex libraryMutex;
+
+// The smallest page size of any platform we run on. Touching more often than once per page does no harm.
+#define WAVETABLE_PREFAULT_STRIDE (4096)
+
+static const void *WavetableMapFile(const std::filesystem::path &path, size_t *size) {
+#ifdef _WIN32
+    const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+    LARGE_INTEGER fileSize;
+    const HANDLE mapping = GetFileSizeEx(file, &fileSize) ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (!mapping) return nullptr;
+
+    // The view keeps the mapping alive on its own.
+    const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    *size = (size_t) fileSize.QuadPart;
+    return view;
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file == -1) return nullptr;
+
+    struct stat information = {};
+    void *view = MAP_FAILED;
+
+    if (fstat(file, &information) == 0 && information.st_size > 0) {
+        view = mmap(nullptr, (size_t) information.st_size, PROT_READ, MAP_SHARED, file, 0);
+    }
+
+    // The mapping keeps the file alive on its own.
+    close(file);
+    *size = (size_t) information.st_size;
+    return view == MAP_FAILED ? nullptr : view;
+#endif
+}
+
+// Bring every page of a new mapping into memory now, on the main thread, rather than on the audio thread's first read of it.
+// The advice starts reading ahead, and touching a byte of each page waits until it's there. Windows has no equivalent
+// that works on every version we support, so it relies on the touches alone.
+static void WavetablePrefault(const void *view, size_t size) {
+#ifndef _WIN32
+    madvise(const_cast<void *>(view), size, MADV_WILLNEED);
+#endif
+
+    const auto *bytes = static_cast<const volatile uint8_t *>(view);
+    uint8_t sink = 0;
+    for (size_t i = 0; i < size; i += WAVETABLE_PREFAULT_STRIDE) sink += bytes[i];
+    sink += bytes[size - 1];
+    (void) sink;
+}
+
+static void WavetableUnmapFile(const void *view, size_t size) {
+#ifdef _WIN32
+    UnmapViewOfFile(view);
+#else
+    munmap(const_cast<void *>(view), size);
+#endif
+}
+
+static bool WavetableValidate(const void *view, size_t size) {
+    if (size < sizeof(WavetableHeader)) return false;
+    const auto *header = static_cast<const WavetableHeader *>(view);
+
+    if (memcmp(header->magic, WAVETABLE_MAGIC, sizeof(header->magic)) || header->version != WAVETABLE_VERSION) return false;
+    if (header->frameLength < 4 || (header->frameLength & (header->frameLength - 1))) return false;
+    if (header->mipCount < 1 || header->mipCount > WAVETABLE_MAX_MIPS) return false;
+
+    return size == sizeof(WavetableHeader) + (size_t) header->mipCount * (header->frameLength + 1) * sizeof(float);
+}
+
+void WavetableLibraryInitialise(const char *pluginPath) {
+    std::error_code error;
+    const std::filesystem::path folder = std::filesystem::path(pluginPath).parent_path() / "wavetables";
+    std::filesystem::path paths[WAVETABLE_MAX_COUNT];
+    uint32_t count = 0;
+
+    for (const auto &file : std::filesystem::directory_iterator(folder, error)) {
+        if (count == WAVETABLE_MAX_COUNT) break;
+        if (file.is_regular_file(error) && file.path().extension() == ".wt") paths[count++] = file.path();
+    }
+
+    // Sort by name, so that the parameter value of a wavetable doesn't depend on the order the OS lists them in.
+    std::sort(paths, paths + count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        libraryEntries[i].path = paths[i];
+        libraryEntries[i].name = paths[i].stem().string();
+    }
+
+    libraryCount = count;
+}
+
+void WavetableLibraryDeinitialise() {
+    for (uint32_t i = 0; i < libraryCount; i++) {
+        assert(!libraryEntries[i].references);
+        libraryEntries[i] = {};
+    }
+
+    libraryCount = 0;
+    MutexDestroy(libraryMutex);
+}
+
+uint32_t WavetableCount() {
+    return libraryCount;
+}
+
+const char *WavetableName(uint32_t index) {
+    return index < libraryCount ? libraryEntries[index].name.c_str() : nullptr;
+}
+
+bool WavetableFind(const char *name, uint32_t *index) {
+    for (uint32_t i = 0; i < libraryCount; i++) {
+        if (libraryEntries[i].name == name) {
+            *index = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const Wavetable *WavetableAcquire(uint32_t index) {
+    if (index >= libraryCount) return nullptr;
+    WavetableEntry *entry = &libraryEntries[index];
+    const Wavetable *wavetable = nullptr;
+
+    MutexAcquire(libraryMutex);
+
+    if (!entry->references) {
+        entry->view = WavetableMapFile(entry->path, &entry->size);
+
+        if (entry->view && !WavetableValidate(entry->view, entry->size)) {
+            WavetableUnmapFile(entry->view, entry->size);
+            entry->view = nullptr;
+        }
+
+        if (entry->view) {
+            WavetablePrefault(entry->view, entry->size);
+            entry->wavetable.header = static_cast<const WavetableHeader *>(entry->view);
+            entry->wavetable.samples = reinterpret_cast<const float *>(entry->wavetable.header + 1);
+        }
+    }
+
+    if (entry->view) {
+        entry->references++;
+        wavetable = &entry->wavetable;
+    }
+
+    MutexRelease(libraryMutex);
+    return wavetable;
+}
+
+void WavetableRelease(const Wavetable *wavetable) {
+    if (!wavetable) return;
+
+    MutexAcquire(libraryMutex);
+
+    // Wavetables handed out by WavetableAcquire point into libraryEntries.
+    WavetableEntry *entry = libraryEntries;
+    while (&entry->wavetable != wavetable) entry++;
+    assert(entry < libraryEntries + libraryCount && entry->references);
+
+    if (--entry->references == 0) {
+        WavetableUnmapFile(entry->view, entry->size);
+        entry->view = nullptr;
+        entry->wavetable = {};
+    }
+
+    MutexRelease(libraryMutex);
+}
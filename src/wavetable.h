@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Wavetables live in a "wavetables" folder next to the plugin binary, one single-cycle table per .wt file.
+// A file is a WavetableHeader followed by mipCount levels of frameLength + 1 floats. Mip level m is band-limited
+// to (frameLength / 2) >> m harmonics, and the extra sample at the end of each level repeats its first sample,
+// so interpolation never has to wrap. Files are memory-mapped read-only and shared by every instance in the process.
+#define WAVETABLE_MAGIC "HCWT"
+#define WAVETABLE_VERSION (1)
+#define WAVETABLE_MAX_COUNT (128)
+#define WAVETABLE_MAX_MIPS (16)
+
+struct WavetableHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t frameLength;
+    uint32_t mipCount;
+};
+
+struct Wavetable {
+    const WavetableHeader *header;
+    const float *samples;
+};
+
+void WavetableLibraryInitialise(const char *pluginPath);
+void WavetableLibraryDeinitialise();
+uint32_t WavetableCount();
+const char *WavetableName(uint32_t index);
+bool WavetableFind(const char *name, uint32_t *index);
+
+// Acquire maps the file and reads it into memory on first use, and otherwise only takes a reference; Release unmaps it
+// with the last reference. The pages are resident when Acquire returns, though the OS may evict them later under memory pressure.
+// Both must be called on the main thread. Returns nullptr if the file can't be mapped or isn't a valid wavetable.
+const Wavetable *WavetableAcquire(uint32_t index);
+void WavetableRelease(const Wavetable *wavetable);
+
+static inline const float *WavetableMip(const Wavetable *wavetable, uint32_t mip) {
+    return wavetable->samples + (size_t) mip * (wavetable->header->frameLength + 1);
+}
@@ -0,0 +1,131 @@
+#include "wavetable.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+// Compares what it costs many instances to load the same wavetable: each reading its own copy onto the heap,
+// against sharing one memory-mapped copy through WavetableAcquire. Reports load time and resident memory per instance.
+// Usage: bench_wavetable [instances]
+
+#define BENCH_FRAME_LENGTH (2048)
+#define BENCH_MIP_COUNT (11)
+
+// Resident memory in KB, or -1 where we don't know how to ask.
+static int64_t ResidentKB() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters = {};
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize / 1024 : -1;
+#elif defined(__linux__)
+    FILE *file = fopen("/proc/self/statm", "r");
+    long size = 0, resident = -1;
+    if (file && fscanf(file, "%ld %ld", &size, &resident) != 2) resident = -1;
+    if (file) fclose(file);
+    return resident < 0 ? -1 : resident * 4;
+#else
+    return -1;
+#endif
+}
+
+// A band-limited saw, with each mip level keeping half the harmonics of the one before.
+static bool WriteSyntheticWavetable(const std::filesystem::path &path) {
+    FILE *file = fopen(path.string().c_str(), "wb");
+    if (!file) return false;
+
+    WavetableHeader header = {};
+    memcpy(header.magic, WAVETABLE_MAGIC, sizeof(header.magic));
+    header.version = WAVETABLE_VERSION;
+    header.frameLength = BENCH_FRAME_LENGTH;
+    header.mipCount = BENCH_MIP_COUNT;
+    fwrite(&header, sizeof(header), 1, file);
+
+    std::vector<float> level(BENCH_FRAME_LENGTH + 1);
+
+    for (uint32_t mip = 0; mip < BENCH_MIP_COUNT; mip++) {
+        const uint32_t harmonics = (BENCH_FRAME_LENGTH / 2) >> mip;
+
+        for (uint32_t i = 0; i < BENCH_FRAME_LENGTH; i++) {
+            float sample = 0.0f;
+            for (uint32_t h = 1; h <= harmonics; h++) sample += sinf(6.2831853f * h * i / BENCH_FRAME_LENGTH) / h;
+            level[i] = sample * 0.5f;
+        }
+
+        level[BENCH_FRAME_LENGTH] = level[0];
+        fwrite(level.data(), sizeof(float), level.size(), file);
+    }
+
+    return fclose(file) == 0;
+}
+
+static void PrintResult(const char *name, double microseconds, int64_t before, int64_t after, int instances) {
+    printf("%-5s %10.1f us total %8.2f us/instance", name, microseconds, microseconds / instances);
+    if (before < 0 || after < 0) printf("      RSS n/a\n");
+    else printf("      RSS +%lld KB (%.1f KB/instance)\n", (long long) (after - before), (double) (after - before) / instances);
+}
+
+int main(int argc, char **argv) {
+    const int instances = argc > 1 ? atoi(argv[1]) : 256;
+    if (instances <= 0) return 1;
+
+    std::error_code error;
+    const std::filesystem::path folder = std::filesystem::temp_directory_path() / "bench_wavetable";
+    const std::filesystem::path path = folder / "wavetables" / "saw.wt";
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    if (!WriteSyntheticWavetable(path)) {
+        fprintf(stderr, "Couldn't write %s.\n", path.string().c_str());
+        return 1;
+    }
+
+    WavetableLibraryInitialise((folder / "bench.clap").string().c_str());
+    uint32_t index;
+    if (!WavetableFind("saw", &index)) return 1;
+    const size_t fileSize = std::filesystem::file_size(path);
+    printf("%d instances, %zu KB wavetable\n", instances, fileSize / 1024);
+
+    // Each sink read touches the data the way rendering would, so the pages really are resident.
+    volatile float sink = 0.0f;
+    std::vector<float *> copies(instances);
+    int64_t before = ResidentKB();
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < instances; i++) {
+        FILE *file = fopen(path.string().c_str(), "rb");
+        copies[i] = static_cast<float *>(malloc(fileSize));
+        if (fread(copies[i], 1, fileSize, file) != fileSize) return 1;
+        fclose(file);
+        sink = sink + copies[i][fileSize / sizeof(float) - 1];
+    }
+
+    PrintResult("heap", std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count(), before, ResidentKB(), instances);
+
+    std::vector<const Wavetable *> mapped(instances);
+    before = ResidentKB();
+    start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < instances; i++) {
+        mapped[i] = WavetableAcquire(index);
+        if (!mapped[i]) return 1;
+    }
+
+    const double mappedMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    const size_t sampleCount = (size_t) mapped[0]->header->mipCount * (mapped[0]->header->frameLength + 1);
+    for (size_t i = 0; i < sampleCount; i += 256) sink = sink + mapped[0]->samples[i];
+    PrintResult("mmap", mappedMicroseconds, before, ResidentKB(), instances);
+
+    for (const Wavetable *wavetable : mapped) WavetableRelease(wavetable);
+    for (float *copy : copies) free(copy);
+    WavetableLibraryDeinitialise();
+    std::filesystem::remove_all(folder, error);
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "headless_host.h"
+#include "plugin.h"
+
+// Drives the editor through tests/gui_stub.cpp: the timer must poll slowly while idle, run per frame only during
+// a drag, and keep going when the host refuses a timer. Sizes must keep the aspect ratio, and set_size must only
+// accept sizes that adjust_size leaves alone.
+
+static void CheckSizing(HeadlessHost *host, const clap_plugin_gui_t *gui) {
+    uint32_t width, height;
+
+    // Adjusted sizes fit inside the request, keep the aspect ratio exactly, and don't change when adjusted again.
+    for (uint32_t requestWidth = 0; requestWidth < GUI_WIDTH * 5; requestWidth += 7) {
+        for (uint32_t requestHeight = 0; requestHeight < GUI_HEIGHT * 5; requestHeight += 11) {
+            width = requestWidth, height = requestHeight;
+            CHECK(gui->adjust_size(host->plugin, &width, &height));
+            CHECK(width * GUI_HEIGHT == height * GUI_WIDTH);
+            CHECK(width >= GUI_WIDTH * GUI_MINIMUM_SCALE && width <= GUI_WIDTH * GUI_MAXIMUM_SCALE);
+            CHECK(width == GUI_WIDTH * GUI_MINIMUM_SCALE || (width <= requestWidth && height <= requestHeight));
+
+            const uint32_t adjustedWidth = width, adjustedHeight = height;
+            CHECK(gui->adjust_size(host->plugin, &width, &height));
+            CHECK(width == adjustedWidth && height == adjustedHeight);
+        }
+    }
+
+    // A size that would need adjusting is refused, and leaves the editor as it was.
+    CHECK(gui->get_size(host->plugin, &width, &height) && width == GUI_WIDTH && height == GUI_HEIGHT);
+    CHECK(!gui->set_size(host->plugin, GUI_WIDTH + 1, GUI_HEIGHT));
+    CHECK(!gui->set_size(host->plugin, GUI_WIDTH * 10, GUI_HEIGHT * 10));
+    CHECK(gui->get_size(host->plugin, &width, &height) && width == GUI_WIDTH && height == GUI_HEIGHT);
+    CHECK(gui->set_size(host->plugin, GUI_WIDTH * 3 / 2, GUI_HEIGHT * 3 / 2));
+    CHECK(gui->get_size(host->plugin, &width, &height) && width == GUI_WIDTH * 3 / 2 && height == GUI_HEIGHT * 3 / 2);
+
+    // A scale becomes the nearest size that fits, which the host then reads back with get_size.
+    CHECK(gui->set_scale(host->plugin, 2.0));
+    CHECK(gui->get_size(host->plugin, &width, &height) && width == GUI_WIDTH * 2 && height == GUI_HEIGHT * 2);
+    CHECK(gui->set_scale(host->plugin, 4.0 / 3.0));
+    CHECK(gui->get_size(host->plugin, &width, &height) && width * GUI_HEIGHT == height * GUI_WIDTH && width <= GUI_WIDTH * 4 / 3);
+    CHECK(gui->set_scale(host->plugin, 100.0));
+    CHECK(gui->get_size(host->plugin, &width, &height) && width == GUI_WIDTH * GUI_MAXIMUM_SCALE);
+    CHECK(!gui->set_scale(host->plugin, 0.0));
+    CHECK(gui->get_size(host->plugin, &width, &height) && width == GUI_WIDTH * GUI_MAXIMUM_SCALE);
+
+    CHECK(gui->set_scale(host->plugin, 1.0));
+    CHECK(gui->get_size(host->plugin, &width, &height) && width == GUI_WIDTH && height == GUI_HEIGHT);
+}
+
+int main(int, char **argv) {
+    clap_entry.init(argv[0]);
+    HeadlessHost host = {};
+    HostCreate(&host);
+
+    auto *plugin = static_cast<MyPlugin *>(host.plugin->plugin_data);
+    const auto *gui = static_cast<const clap_plugin_gui_t *>(host.plugin->get_extension(host.plugin, CLAP_EXT_GUI));
+    CHECK(gui->create(host.plugin, CLAP_WINDOW_API_WIN32, false));
+    CheckSizing(&host, gui);
+
+    // No timer until the editor is shown.
+    CHECK(host.timerID == CLAP_INVALID_ID);
+    CHECK(gui->show(host.plugin));
+    CHECK(host.timerID != CLAP_INVALID_ID && host.timerInterval == GUI_AUTOMATION_INTERVAL_MS);
+
+    PluginProcessMousePress(plugin, 25, 25);
+    CHECK(host.timerID != CLAP_INVALID_ID && host.timerInterval == GUI_FRAME_INTERVAL_MS);
+
+    // Drags are coalesced until the next frame.
+    const float origin = plugin->mainParameters[P_VOLUME];
+    CHECK(!PluginQueueMouseDrag(plugin, 25, 15));
+    CHECK(plugin->mainParameters[P_VOLUME] == origin);
+    HostFireTimer(&host);
+    CHECK(plugin->mainParameters[P_VOLUME] > origin);
+
+    PluginProcessMouseRelease(plugin);
+    CHECK(host.timerID != CLAP_INVALID_ID && host.timerInterval == GUI_AUTOMATION_INTERVAL_MS);
+
+    // If the host won't give us a frame timer, drags apply immediately, and polling resumes after the release.
+    host.failTimerRegistrations = 1;
+    PluginProcessMousePress(plugin, 25, 25);
+    CHECK(host.timerID == CLAP_INVALID_ID);
+    CHECK(PluginQueueMouseDrag(plugin, 25, 20));
+    PluginProcessMouseRelease(plugin);
+    CHECK(host.timerID != CLAP_INVALID_ID && host.timerInterval == GUI_AUTOMATION_INTERVAL_MS);
+
+    // Hidden, nothing runs, and a drag that ends while hidden doesn't bring the timer back.
+    PluginProcessMousePress(plugin, 25, 25);
+    CHECK(gui->hide(host.plugin));
+    CHECK(host.timerID == CLAP_INVALID_ID);
+    PluginProcessMouseRelease(plugin);
+    CHECK(host.timerID == CLAP_INVALID_ID);
+
+    gui->destroy(host.plugin);
+    HostDestroy(&host);
+    clap_entry.deinit();
+    return testFailures != 0;
+}
@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <cassert>
+#include "plugin.h"
+
+// Stands in for gui.cpp in the headless tests, which have no window to show. Painting still goes through
+// PluginPaintStatic and PluginPaint, into buffers nobody looks at, so the tests run the same code as a real editor.
+
+struct GUI {
+	uint32_t *bits{};
+	uint32_t *staticBits{};
+	uint32_t width{}, height{};
+};
+
+void GUIPaint(MyPlugin *plugin, const bool internal) {
+	if (internal) PluginPaint(plugin, plugin->gui->bits, plugin->gui->staticBits);
+}
+
+static void GUIAllocateBuffers(MyPlugin *plugin) {
+	GUI *gui = plugin->gui;
+	gui->width = plugin->guiWidth;
+	gui->height = plugin->guiHeight;
+	gui->bits = static_cast<uint32_t *>(realloc(gui->bits, gui->width * gui->height * 4));
+	gui->staticBits = static_cast<uint32_t *>(realloc(gui->staticBits, gui->width * gui->height * 4));
+
+	PluginPaintStatic(plugin, gui->staticBits);
+	memcpy(gui->bits, gui->staticBits, gui->width * gui->height * 4);
+}
+
+void GUICreate(MyPlugin *plugin) {
+	assert(!plugin->gui);
+	plugin->gui = static_cast<GUI *>(calloc(1, sizeof(GUI)));
+	GUIAllocateBuffers(plugin);
+}
+
+void GUIResize(MyPlugin *plugin) {
+	if (plugin->gui->width == plugin->guiWidth && plugin->gui->height == plugin->guiHeight) return;
+	GUIAllocateBuffers(plugin);
+	GUIPaint(plugin, false);
+}
+
+void GUIDestroy(MyPlugin *plugin) {
+	assert(plugin->gui);
+	free(plugin->gui->bits);
+	free(plugin->gui->staticBits);
+	free(plugin->gui);
+	plugin->gui = nullptr;
+}
+
+void GUISetParent(const MyPlugin *, const clap_window_t *) {}
+void GUISetVisible(const MyPlugin *, const bool) {}
+void GUIOnPOSIXFD(MyPlugin *) {}
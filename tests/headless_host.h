@@ -0,0 +1,279 @@
+#pragma once
+
+// A host with no window and no audio device, for driving the plugin from the tests and benchmarks.
+// Events queued with HostQueueEvent are delivered by the next HostProcess or HostFlush, and whatever the plugin
+// sends back is collected in HeadlessHost::output. Timers only fire when the test calls HostFireTimer.
+
+#include "clap/clap.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+extern "C" const clap_plugin_entry_t clap_entry;
+
+static int testFailures = 0;
+
+// Failures are counted rather than fatal, so one run reports every broken check. Tests return testFailures != 0.
+#define CHECK(condition) do { \
+    if (!(condition)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); testFailures++; } \
+} while (0)
+
+struct HeadlessHost {
+    clap_host_t host;
+    const clap_plugin_t *plugin;
+    const clap_plugin_params_t *params;
+    const clap_plugin_render_t *render;
+    const clap_plugin_tail_t *tail;
+    const clap_plugin_timer_support_t *timerSupport;
+    bool active;
+
+    // Each event is copied into its own buffer of 64-bit words, which keeps its doubles aligned.
+    std::vector<std::vector<uint64_t>> input, output;
+
+    // Requests the plugin makes of the host, which may come from any thread.
+    std::atomic<uint32_t> flushRequests, callbackRequests;
+
+    // tail.changed may only be called from process(), so count any calls made elsewhere separately.
+    std::atomic<bool> processing;
+    std::atomic<uint32_t> tailChanges, misplacedTailChanges;
+
+    // The plugin only ever registers one timer at a time. Tests can make the next few registrations fail.
+    clap_id timerID;
+    uint32_t timerInterval;
+    clap_id nextTimerID;
+    uint32_t failTimerRegistrations;
+};
+
+static HeadlessHost *HostFromCLAP(const clap_host_t *host) {
+    return static_cast<HeadlessHost *>(host->host_data);
+}
+
+static constexpr clap_host_params_t hostExtensionParams = {
+    .rescan = [] (const clap_host_t *, clap_param_rescan_flags) {},
+    .clear = [] (const clap_host_t *, clap_id, clap_param_clear_flags) {},
+    .request_flush = [] (const clap_host_t *host) { HostFromCLAP(host)->flushRequests++; },
+};
+
+static constexpr clap_host_timer_support_t hostExtensionTimerSupport = {
+    .register_timer = [] (const clap_host_t *_host, uint32_t interval, clap_id *timerID) -> bool {
+        HeadlessHost *host = HostFromCLAP(_host);
+        if (host->timerID != CLAP_INVALID_ID) return false;
+        if (host->failTimerRegistrations && host->failTimerRegistrations--) return false;
+        *timerID = host->timerID = host->nextTimerID++;
+        host->timerInterval = interval;
+        return true;
+    },
+
+    .unregister_timer = [] (const clap_host_t *_host, clap_id timerID) -> bool {
+        HeadlessHost *host = HostFromCLAP(_host);
+        if (host->timerID != timerID) return false;
+        host->timerID = CLAP_INVALID_ID;
+        return true;
+    },
+};
+
+static constexpr clap_host_tail_t hostExtensionTail = {
+    .changed = [] (const clap_host_t *_host) {
+        HeadlessHost *host = HostFromCLAP(_host);
+        (host->processing ? host->tailChanges : host->misplacedTailChanges)++;
+    },
+};
+
+static const void *HostGetExtension(const clap_host_t *, const char *id) {
+    if (0 == strcmp(id, CLAP_EXT_PARAMS       )) return &hostExtensionParams;
+    if (0 == strcmp(id, CLAP_EXT_TIMER_SUPPORT)) return &hostExtensionTimerSupport;
+    if (0 == strcmp(id, CLAP_EXT_TAIL         )) return &hostExtensionTail;
+    return nullptr;
+}
+
+static void HostCreate(HeadlessHost *host) {
+    host->host = {
+        .clap_version = CLAP_VERSION_INIT,
+        .host_data = host,
+        .name = "Headless",
+        .vendor = "joeloftus",
+        .url = "",
+        .version = "1.0.0",
+        .get_extension = HostGetExtension,
+        .request_restart = [] (const clap_host_t *) {},
+        .request_process = [] (const clap_host_t *) {},
+        .request_callback = [] (const clap_host_t *host) { HostFromCLAP(host)->callbackRequests++; },
+    };
+
+    host->timerID = CLAP_INVALID_ID;
+    host->nextTimerID = 1;
+
+    const auto *factory = static_cast<const clap_plugin_factory_t *>(clap_entry.get_factory(CLAP_PLUGIN_FACTORY_ID));
+    host->plugin = factory->create_plugin(factory, &host->host, factory->get_plugin_descriptor(factory, 0)->id);
+    host->plugin->init(host->plugin);
+
+    host->params = static_cast<const clap_plugin_params_t *>(host->plugin->get_extension(host->plugin, CLAP_EXT_PARAMS));
+    host->render = static_cast<const clap_plugin_render_t *>(host->plugin->get_extension(host->plugin, CLAP_EXT_RENDER));
+    host->tail = static_cast<const clap_plugin_tail_t *>(host->plugin->get_extension(host->plugin, CLAP_EXT_TAIL));
+    host->timerSupport = static_cast<const clap_plugin_timer_support_t *>(host->plugin->get_extension(host->plugin, CLAP_EXT_TIMER_SUPPORT));
+}
+
+static void HostActivate(HeadlessHost *host, double sampleRate) {
+    host->plugin->activate(host->plugin, sampleRate, 1, 4096);
+    host->plugin->start_processing(host->plugin);
+    host->active = true;
+}
+
+static void HostDeactivate(HeadlessHost *host) {
+    host->plugin->stop_processing(host->plugin);
+    host->plugin->deactivate(host->plugin);
+    host->active = false;
+}
+
+static void HostDestroy(HeadlessHost *host) {
+    if (host->active) HostDeactivate(host);
+    host->plugin->destroy(host->plugin);
+    host->plugin = nullptr;
+}
+
+template <class T>
+static void HostQueueEvent(HeadlessHost *host, T event) {
+    event.header.size = sizeof(T);
+    event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+    std::vector<uint64_t> &copy = host->input.emplace_back((sizeof(T) + 7) / 8);
+    memcpy(copy.data(), &event, sizeof(T));
+}
+
+static void HostQueueNote(HeadlessHost *host, uint16_t type, int16_t key, int32_t noteID, uint32_t time) {
+    clap_event_note_t event = {};
+    event.header.type = type;
+    event.header.time = time;
+    event.note_id = noteID;
+    event.port_index = 0;
+    event.channel = 0;
+    event.key = key;
+    event.velocity = 1.0;
+    HostQueueEvent(host, event);
+}
+
+static void HostQueueParameter(HeadlessHost *host, clap_id parameter, double value, uint32_t time) {
+    clap_event_param_value_t event = {};
+    event.header.type = CLAP_EVENT_PARAM_VALUE;
+    event.header.time = time;
+    event.param_id = parameter;
+    event.note_id = -1;
+    event.port_index = -1;
+    event.channel = -1;
+    event.key = -1;
+    event.value = value;
+    HostQueueEvent(host, event);
+}
+
+static clap_input_events_t HostInputEvents(HeadlessHost *host) {
+    return {
+        .ctx = host,
+        .size = [] (const clap_input_events_t *list) -> uint32_t {
+            return static_cast<HeadlessHost *>(list->ctx)->input.size();
+        },
+        .get = [] (const clap_input_events_t *list, uint32_t index) -> const clap_event_header_t * {
+            return reinterpret_cast<const clap_event_header_t *>(static_cast<HeadlessHost *>(list->ctx)->input[index].data());
+        },
+    };
+}
+
+static clap_output_events_t HostOutputEvents(HeadlessHost *host) {
+    return {
+        .ctx = host,
+        .try_push = [] (const clap_output_events_t *list, const clap_event_header_t *event) -> bool {
+            std::vector<uint64_t> &copy = static_cast<HeadlessHost *>(list->ctx)->output.emplace_back((event->size + 7) / 8);
+            memcpy(copy.data(), event, event->size);
+            return true;
+        },
+    };
+}
+
+// Render frames of stereo output, delivering every queued event. Must be called on the audio thread.
+static clap_process_status HostProcess(HeadlessHost *host, uint32_t frames, float *left, float *right) {
+    float *channels[2] = { left, right };
+    clap_audio_buffer_t outputBuffer = { .data32 = channels, .data64 = nullptr, .channel_count = 2, .latency = 0, .constant_mask = 0 };
+    const clap_input_events_t in = HostInputEvents(host);
+    const clap_output_events_t out = HostOutputEvents(host);
+
+    clap_process_t process = {};
+    process.steady_time = -1;
+    process.frames_count = frames;
+    process.audio_outputs = &outputBuffer;
+    process.audio_outputs_count = 1;
+    process.in_events = &in;
+    process.out_events = &out;
+
+    host->processing = true;
+    const clap_process_status status = host->plugin->process(host->plugin, &process);
+    host->processing = false;
+    host->input.clear();
+    return status;
+}
+
+// Deliver every queued event without processing audio. Must be called on the audio thread while active,
+// and on the main thread otherwise.
+static void HostFlush(HeadlessHost *host) {
+    const clap_input_events_t in = HostInputEvents(host);
+    const clap_output_events_t out = HostOutputEvents(host);
+    host->params->flush(host->plugin, &in, &out);
+    host->input.clear();
+}
+
+static void HostFireTimer(HeadlessHost *host) {
+    if (host->timerID != CLAP_INVALID_ID) host->timerSupport->on_timer(host->plugin, host->timerID);
+}
+
+static const clap_event_header_t *HostOutputEvent(HeadlessHost *host, size_t index) {
+    return reinterpret_cast<const clap_event_header_t *>(host->output[index].data());
+}
+
+// The streams move a few bytes per call, as hosts are allowed to, so the plugin's handling of short transfers is exercised too.
+#define HOST_STREAM_CHUNK (7)
+
+struct HostStream {
+    std::vector<uint8_t> *bytes;
+    size_t position;
+};
+
+static bool HostSaveState(HeadlessHost *host, std::vector<uint8_t> *bytes) {
+    const auto *state = static_cast<const clap_plugin_state_t *>(host->plugin->get_extension(host->plugin, CLAP_EXT_STATE));
+    HostStream stream = { bytes, 0 };
+    bytes->clear();
+
+    clap_ostream_t output = {
+        .ctx = &stream,
+        .write = [] (const clap_ostream_t *output, const void *buffer, uint64_t size) -> int64_t {
+            auto *stream = static_cast<HostStream *>(output->ctx);
+            size = std::min<uint64_t>(size, HOST_STREAM_CHUNK);
+            stream->bytes->insert(stream->bytes->end(), static_cast<const uint8_t *>(buffer), static_cast<const uint8_t *>(buffer) + size);
+            return (int64_t) size;
+        },
+    };
+
+    return state->save(host->plugin, &output);
+}
+
+static bool HostLoadState(HeadlessHost *host, const std::vector<uint8_t> &bytes) {
+    const auto *state = static_cast<const clap_plugin_state_t *>(host->plugin->get_extension(host->plugin, CLAP_EXT_STATE));
+    HostStream stream = { const_cast<std::vector<uint8_t> *>(&bytes), 0 };
+
+    clap_istream_t input = {
+        .ctx = &stream,
+        .read = [] (const clap_istream_t *input, void *buffer, uint64_t size) -> int64_t {
+            auto *stream = static_cast<HostStream *>(input->ctx);
+            size = std::min<uint64_t>({ size, HOST_STREAM_CHUNK, stream->bytes->size() - stream->position });
+            memcpy(buffer, stream->bytes->data() + stream->position, size);
+            stream->position += size;
+            return (int64_t) size;
+        },
+    };
+
+    return state->load(host->plugin, &input);
+}
+
+static double HostParameterValue(HeadlessHost *host, clap_id parameter) {
+    double value = 0.0;
+    host->params->get_value(host->plugin, parameter, &value);
+    return value;
+}
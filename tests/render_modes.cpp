@@ -0,0 +1,103 @@
+#include "headless_host.h"
+#include "plugin.h"
+#include <cmath>
+#include <thread>
+
+// Renders the same chord in realtime and offline mode and checks that they agree. The modes differ in block size
+// and oscillator, so they can't be bit-exact, but any difference beyond the sine table's error means they've diverged.
+// Built with a fixed RENDER_OFFLINE_THREADS, so the render pool is used however many cores the machine has.
+
+#define SAMPLE_RATE (48000)
+#define HOST_BLOCK (512)
+#define CHORD_NOTES (12) // Enough to use the render pool when offline, see RENDER_PARALLEL_MIN_VOICES.
+#define TOLERANCE (1e-4f)
+
+static std::vector<float> RenderChord(HeadlessHost *host) {
+    std::vector<float> rendered;
+    float left[HOST_BLOCK], right[HOST_BLOCK];
+
+    for (int i = 0; i < CHORD_NOTES; i++) {
+        HostQueueNote(host, CLAP_EVENT_NOTE_ON, 48 + i * 2, i, 0);
+    }
+
+    for (uint32_t block = 0; block < SAMPLE_RATE * 2 / HOST_BLOCK; block++) {
+        // Release halfway through a host block, so the modes split their blocks at different points.
+        if (block == SAMPLE_RATE / HOST_BLOCK) HostQueueNote(host, CLAP_EVENT_NOTE_OFF, -1, -1, HOST_BLOCK / 2);
+        HostProcess(host, HOST_BLOCK, left, right);
+        rendered.insert(rendered.end(), left, left + HOST_BLOCK);
+        CHECK(!memcmp(left, right, sizeof(left)));
+    }
+
+    return rendered;
+}
+
+static float LargestDifference(const std::vector<float> &a, const std::vector<float> &b) {
+    float difference = 0.0f;
+    for (size_t i = 0; i < a.size(); i++) difference = std::max(difference, fabsf(a[i] - b[i]));
+    return difference;
+}
+
+int main(int, char **argv) {
+    // The test's own folder has no wavetables, so both modes use the built-in sine.
+    clap_entry.init(argv[0]);
+
+    HeadlessHost realtime = {}, offline = {};
+    HostCreate(&realtime);
+    HostCreate(&offline);
+
+    CHECK(realtime.render && offline.render);
+    CHECK(!offline.render->has_hard_realtime_requirement(offline.plugin));
+    CHECK(!offline.render->set(offline.plugin, 2));
+    CHECK(offline.render->set(offline.plugin, CLAP_RENDER_OFFLINE));
+
+    HostActivate(&realtime, SAMPLE_RATE);
+    HostActivate(&offline, SAMPLE_RATE);
+
+    // The pool is ready before the first process() call, and only offline instances hold it.
+    const auto *realtimePlugin = static_cast<const MyPlugin *>(realtime.plugin->plugin_data);
+    const auto *offlinePlugin = static_cast<const MyPlugin *>(offline.plugin->plugin_data);
+    CHECK(offlinePlugin->renderPool && !realtimePlugin->renderPool);
+
+    // Every offline instance shares the same pool, and switching while inactive is picked up on activation.
+    HeadlessHost another = {};
+    HostCreate(&another);
+    CHECK(another.render->set(another.plugin, CLAP_RENDER_OFFLINE));
+    HostActivate(&another, SAMPLE_RATE);
+    CHECK(static_cast<const MyPlugin *>(another.plugin->plugin_data)->renderPool == offlinePlugin->renderPool);
+
+    // The two offline instances render at the same time, so blocks that find the pool busy render on their own thread.
+    const std::vector<float> realtimeOutput = RenderChord(&realtime);
+    std::vector<float> offlineOutput, anotherOutput;
+    std::thread anotherThread([&] { anotherOutput = RenderChord(&another); });
+    offlineOutput = RenderChord(&offline);
+    anotherThread.join();
+    HostDestroy(&another);
+
+    float peak = 0.0f;
+    for (float sample : offlineOutput) peak = std::max(peak, fabsf(sample));
+    const float difference = std::max(LargestDifference(offlineOutput, realtimeOutput), LargestDifference(anotherOutput, realtimeOutput));
+    printf("peak %f, largest difference between modes %g\n", peak, difference);
+    CHECK(peak > 0.1f);
+    CHECK(difference < TOLERANCE);
+
+    // Switching back is picked up at the start of the next block, after which both render identically.
+    CHECK(offline.render->set(offline.plugin, CLAP_RENDER_REALTIME));
+    float left[HOST_BLOCK], right[HOST_BLOCK], expected[HOST_BLOCK];
+    HostQueueNote(&realtime, CLAP_EVENT_NOTE_ON, 60, 100, 0);
+    HostQueueNote(&offline, CLAP_EVENT_NOTE_ON, 60, 100, 0);
+    HostProcess(&realtime, HOST_BLOCK, expected, right);
+    HostProcess(&offline, HOST_BLOCK, left, right);
+    CHECK(!memcmp(left, expected, sizeof(left)));
+
+    // The pool is given up on deactivation, and taken again on activation while the mode is offline.
+    HostDeactivate(&offline);
+    CHECK(!offlinePlugin->renderPool && !offlinePlugin->mainRenderPool);
+    CHECK(offline.render->set(offline.plugin, CLAP_RENDER_OFFLINE));
+    HostActivate(&offline, SAMPLE_RATE);
+    CHECK(offlinePlugin->renderPool);
+
+    HostDestroy(&realtime);
+    HostDestroy(&offline);
+    clap_entry.deinit();
+    return testFailures != 0;
+}
@@ -0,0 +1,74 @@
+#include "headless_host.h"
+#include "plugin.h"
+#include <cmath>
+
+// Saves and loads the plugin's state: round trips must be byte-exact, the original volume-only layout must still load,
+// and whatever a state contains, parameters must end up within their ranges.
+
+template <class T>
+static void Append(std::vector<uint8_t> *bytes, T value) {
+    const size_t position = bytes->size();
+    bytes->resize(position + sizeof(T));
+    memcpy(bytes->data() + position, &value, sizeof(T));
+}
+
+static bool Near(double value, double expected) {
+    return fabs(value - expected) < 1e-6;
+}
+
+int main(int, char **argv) {
+    clap_entry.init(argv[0]);
+
+    HeadlessHost source = {}, destination = {};
+    HostCreate(&source);
+    HostCreate(&destination);
+    HostActivate(&source, 48000);
+
+    // Values set by the host reach the state through the audio thread.
+    float left[64], right[64];
+    HostQueueParameter(&source, P_VOLUME, 0.25, 0);
+    HostQueueParameter(&source, P_RELEASE, 1.5, 0);
+    HostProcess(&source, 64, left, right);
+
+    std::vector<uint8_t> saved, resaved;
+    CHECK(HostSaveState(&source, &saved));
+    CHECK(HostLoadState(&destination, saved));
+    CHECK(HostSaveState(&destination, &resaved));
+    CHECK(saved == resaved);
+    CHECK(Near(HostParameterValue(&destination, P_VOLUME), 0.25));
+    CHECK(Near(HostParameterValue(&destination, P_RELEASE), 1.5));
+
+    // Out of range and non-finite values are brought back into range, and values for parameters we don't have are skipped.
+    std::vector<uint8_t> state;
+    Append<uint32_t>(&state, STATE_MAGIC);
+    Append<uint32_t>(&state, STATE_VERSION);
+    Append<uint32_t>(&state, P_COUNT + 2);
+    for (uint32_t i = 0; i < P_COUNT + 2; i++) Append<float>(&state, i == P_VOLUME ? 7.0f : i == P_RELEASE ? NAN : 5.0f);
+    Append<uint32_t>(&state, 0);
+    CHECK(HostLoadState(&destination, state));
+    CHECK(Near(HostParameterValue(&destination, P_VOLUME), 1.0));
+    CHECK(Near(HostParameterValue(&destination, P_WAVETABLE), 0.0)); // The library is empty.
+    CHECK(Near(HostParameterValue(&destination, P_RELEASE), 0.3));
+
+    // Truncated states and states from a newer version are rejected.
+    CHECK(!HostLoadState(&destination, std::vector<uint8_t>(saved.begin(), saved.end() - 5)));
+    state = saved;
+    state[4]++;
+    CHECK(!HostLoadState(&destination, state));
+
+    // The first version only saved the volume.
+    state.clear();
+    Append<float>(&state, 0.75f);
+    CHECK(HostLoadState(&destination, state));
+    CHECK(Near(HostParameterValue(&destination, P_VOLUME), 0.75));
+    CHECK(Near(HostParameterValue(&destination, P_RELEASE), 0.3));
+
+    // Anything else without the magic number isn't a state of ours.
+    Append<float>(&state, 0.5f);
+    CHECK(!HostLoadState(&destination, state));
+
+    HostDestroy(&source);
+    HostDestroy(&destination);
+    clap_entry.deinit();
+    return testFailures != 0;
+}
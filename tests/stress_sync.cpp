@@ -0,0 +1,137 @@
+#include "headless_host.h"
+#include "plugin.h"
+#include <thread>
+
+// Hammers the main/audio thread synchronization from both sides at once. The audio thread alternates process()
+// with notes and flush() with automation, while the main thread drags the dial, runs the GUI timer, reads values
+// and saves and loads state. Meant to be run under ThreadSanitizer (PLUGIN_SANITIZE_THREAD), and built with
+// PLUGIN_SYNC_STATS, so the lock's wait and hold times are reported when the plugin is destroyed.
+// Usage: stress_sync [iterations]
+
+#define HOST_BLOCK (256)
+
+struct AudioThreadResult {
+    float lastRelease;
+};
+
+static void AudioThread(HeadlessHost *host, const std::atomic<bool> *stop, AudioThreadResult *result) {
+    float left[HOST_BLOCK], right[HOST_BLOCK];
+
+    for (uint32_t block = 0; !*stop; block++) {
+        if (block & 1) {
+            result->lastRelease = 0.1f + (block % 100) * 0.01f;
+            HostQueueParameter(host, P_RELEASE, result->lastRelease, 0);
+            HostFlush(host);
+        } else {
+            if (block % 32 == 0) HostQueueNote(host, CLAP_EVENT_NOTE_ON, 48 + block / 32 % 24, block, 0);
+            if (block % 32 == 16) HostQueueNote(host, CLAP_EVENT_NOTE_OFF, -1, -1, 0);
+            HostProcess(host, HOST_BLOCK, left, right);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const int iterations = argc > 1 ? atoi(argv[1]) : 5000;
+    clap_entry.init(argv[0]);
+
+    HeadlessHost host = {}, copy = {};
+    HostCreate(&host);
+    HostCreate(&copy);
+    HostActivate(&host, 48000);
+
+    auto *plugin = static_cast<MyPlugin *>(host.plugin->plugin_data);
+    const auto *gui = static_cast<const clap_plugin_gui_t *>(host.plugin->get_extension(host.plugin, CLAP_EXT_GUI));
+    CHECK(gui->create(host.plugin, CLAP_WINDOW_API_WIN32, false));
+    CHECK(gui->show(host.plugin));
+
+    std::atomic<bool> stop = false;
+    AudioThreadResult audioResult = {};
+    std::thread audio(AudioThread, &host, &stop, &audioResult);
+
+    std::vector<uint8_t> saved, copied;
+    float lastLoadedRelease = -1.0f;
+    int presses = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        // A drag that runs across a few frames, with several mouse moves per frame.
+        PluginProcessMousePress(plugin, 25, 25);
+        presses++;
+
+        for (int move = 0; move < 8; move++) {
+            PluginQueueMouseDrag(plugin, 25, 25 - (i + move) % 40);
+            if (move % 3 == 2) HostFireTimer(&host);
+        }
+
+        PluginProcessMouseRelease(plugin);
+        HostParameterValue(&host, P_VOLUME);
+        HostParameterValue(&host, P_RELEASE);
+        if (i % 5 == 0) HostFireTimer(&host);
+
+        // Whatever state the main thread sees, it must survive a round trip through another instance unchanged.
+        if (i % 64 == 0) {
+            CHECK(HostSaveState(&host, &saved));
+            CHECK(HostLoadState(&copy, saved));
+            CHECK(HostSaveState(&copy, &copied));
+            CHECK(saved == copied);
+
+            if (i % 256 == 0) {
+                CHECK(HostLoadState(&host, saved));
+                lastLoadedRelease = plugin->mainParameters[P_RELEASE];
+            }
+        }
+    }
+
+    stop = true;
+    audio.join();
+
+    // With both threads quiet, push the main thread's last changes through and pull the audio thread's back.
+    HostFlush(&host);
+    HostFireTimer(&host);
+
+    // Gestures must pair up, one for each drag, and every value sent must be one the GUI could have set.
+    bool active = false;
+    int begins = 0, ends = 0, badValues = 0;
+    float lastVolumeSent = -1.0f;
+
+    for (size_t i = 0; i < host.output.size(); i++) {
+        const clap_event_header_t *event = HostOutputEvent(&host, i);
+
+        if (event->type == CLAP_EVENT_PARAM_GESTURE_BEGIN || event->type == CLAP_EVENT_PARAM_GESTURE_END) {
+            const bool begin = event->type == CLAP_EVENT_PARAM_GESTURE_BEGIN;
+            CHECK(reinterpret_cast<const clap_event_param_gesture_t *>(event)->param_id == P_VOLUME);
+            CHECK(begin != active);
+            active = begin;
+            (begin ? begins : ends)++;
+        } else if (event->type == CLAP_EVENT_PARAM_VALUE) {
+            const auto *valueEvent = reinterpret_cast<const clap_event_param_value_t *>(event);
+            if (valueEvent->param_id != P_VOLUME) continue;
+            if (valueEvent->value < 0.0 || valueEvent->value > 1.0) badValues++;
+            lastVolumeSent = (float) valueEvent->value;
+        }
+    }
+
+    printf("%d drags, %d gesture begins, %d ends, %zu events sent, %u flush requests\n",
+            presses, begins, ends, host.output.size(), host.flushRequests.load());
+    CHECK(!active);
+    CHECK(begins == presses && ends == presses);
+    CHECK(!badValues);
+
+    // No update may be lost: both threads agree on every value, the host was told the last one the GUI set, and the
+    // release is whichever came last of the automation and the state loads.
+    for (uint32_t i = 0; i < P_COUNT; i++) {
+        CHECK(plugin->parameters[i] == plugin->mainParameters[i]);
+        CHECK(!plugin->changed[i] && !plugin->mainChanged[i]);
+        CHECK(!plugin->gesturesPending[i] && !plugin->gestureActive[i]);
+    }
+
+    CHECK(lastVolumeSent == plugin->mainParameters[P_VOLUME]);
+    CHECK((float) HostParameterValue(&host, P_VOLUME) == lastVolumeSent);
+    CHECK(plugin->parameters[P_RELEASE] == audioResult.lastRelease || plugin->parameters[P_RELEASE] == lastLoadedRelease);
+
+    gui->hide(host.plugin);
+    gui->destroy(host.plugin);
+    HostDestroy(&host);
+    HostDestroy(&copy);
+    clap_entry.deinit();
+    return testFailures != 0;
+}
@@ -0,0 +1,85 @@
+#include "headless_host.h"
+#include "plugin.h"
+
+// Checks that a released voice ends when the tail extension says it will, that process() then asks to sleep,
+// and that every change to the tail reaches the host through tail.changed from within process().
+
+#define SAMPLE_RATE (48000)
+#define HOST_BLOCK (256)
+
+// Play a note, release it, and count the frames until its NOTE_END. Returns 0 if it never ends.
+static uint32_t FramesUntilNoteEnd(HeadlessHost *host) {
+    float left[HOST_BLOCK], right[HOST_BLOCK];
+    HostQueueNote(host, CLAP_EVENT_NOTE_ON, 60, 1, 0);
+    CHECK(HostProcess(host, HOST_BLOCK, left, right) == CLAP_PROCESS_CONTINUE);
+    HostQueueNote(host, CLAP_EVENT_NOTE_OFF, 60, 1, 0);
+
+    for (uint32_t frames = HOST_BLOCK; frames < SAMPLE_RATE * 20; frames += HOST_BLOCK) {
+        host->output.clear();
+        const clap_process_status status = HostProcess(host, HOST_BLOCK, left, right);
+
+        if (host->output.size()) {
+            CHECK(host->output.size() == 1 && HostOutputEvent(host, 0)->type == CLAP_EVENT_NOTE_END);
+            CHECK(status == CLAP_PROCESS_SLEEP);
+            return frames;
+        }
+
+        CHECK(status == CLAP_PROCESS_CONTINUE);
+    }
+
+    return 0;
+}
+
+static void CheckTail(HeadlessHost *host, uint32_t expected) {
+    const uint32_t tail = host->tail->get(host->plugin);
+    const uint32_t frames = FramesUntilNoteEnd(host);
+    printf("tail %u frames, expected %u, note ended after %u\n", tail, expected, frames);
+    CHECK(tail >= expected && tail <= expected + 1); // Rounded up from a float.
+
+    // Voices are retired at the end of the block in which they cross the floor.
+    CHECK(frames + 1 >= tail && frames < tail + HOST_BLOCK);
+}
+
+int main(int, char **argv) {
+    clap_entry.init(argv[0]);
+    HeadlessHost host = {};
+    HostCreate(&host);
+    HostActivate(&host, SAMPLE_RATE);
+    float left[HOST_BLOCK], right[HOST_BLOCK];
+
+    // The defaults: 0.3 s to fall 60 dB, retired at -80 dB.
+    CheckTail(&host, SAMPLE_RATE * 3 / 10 * 80 / 60);
+    CHECK(!host.tailChanges);
+
+    // Automation reports the change once, from the same process() call.
+    HostQueueParameter(&host, P_RETIRE_FLOOR, -40.0, 0);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(host.tailChanges == 1);
+    CheckTail(&host, SAMPLE_RATE * 3 / 10 * 40 / 60);
+
+    // A change flushed while inactive, on the main thread, waits for the next process() to be reported.
+    HostDeactivate(&host);
+    HostQueueParameter(&host, P_RELEASE, 0.6, 0);
+    HostFlush(&host);
+    CHECK(host.tailChanges == 1);
+    HostActivate(&host, SAMPLE_RATE);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(host.tailChanges == 2);
+    CheckTail(&host, SAMPLE_RATE * 6 / 10 * 40 / 60);
+
+    // So does one the main thread makes itself, here by loading the default state of another instance.
+    HeadlessHost defaults = {};
+    HostCreate(&defaults);
+    std::vector<uint8_t> state;
+    CHECK(HostSaveState(&defaults, &state));
+    CHECK(HostLoadState(&host, state));
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(host.tailChanges == 3);
+    CheckTail(&host, SAMPLE_RATE * 3 / 10 * 80 / 60);
+
+    CHECK(!host.misplacedTailChanges);
+    HostDestroy(&defaults);
+    HostDestroy(&host);
+    clap_entry.deinit();
+    return testFailures != 0;
+}
@@ -0,0 +1,221 @@
+#include "headless_host.h"
+#include "plugin.h"
+#include <cmath>
+
+// Checks voice stealing, that tuning expressions and the Tuning parameter reach the voices they target, and that
+// polyphonic modulation reaches every voice its target covers and is given back to the pool once it has faded out.
+
+#define SAMPLE_RATE (48000)
+#define HOST_BLOCK (256)
+
+static MyPlugin *PluginFromHost(HeadlessHost *host) {
+    return static_cast<MyPlugin *>(host->plugin->plugin_data);
+}
+
+static void QueueNote(HeadlessHost *host, uint16_t type, int16_t channel, int16_t key, int32_t noteID) {
+    clap_event_note_t event = {};
+    event.header.type = type;
+    event.note_id = noteID;
+    event.channel = channel;
+    event.key = key;
+    event.velocity = 1.0;
+    HostQueueEvent(host, event);
+}
+
+static void QueueModulation(HeadlessHost *host, int16_t channel, int16_t key, double amount) {
+    clap_event_param_mod_t event = {};
+    event.header.type = CLAP_EVENT_PARAM_MOD;
+    event.param_id = P_VOLUME;
+    event.note_id = -1;
+    event.port_index = -1;
+    event.channel = channel;
+    event.key = key;
+    event.amount = amount;
+    HostQueueEvent(host, event);
+}
+
+static void QueueTuning(HeadlessHost *host, int32_t noteID, double semitones) {
+    clap_event_note_expression_t event = {};
+    event.header.type = CLAP_EVENT_NOTE_EXPRESSION;
+    event.expression_id = CLAP_NOTE_EXPRESSION_TUNING;
+    event.note_id = noteID;
+    event.port_index = -1;
+    event.channel = -1;
+    event.key = -1;
+    event.value = semitones;
+    HostQueueEvent(host, event);
+}
+
+static bool Near(float value, float expected) {
+    return fabsf(value - expected) < expected * 1e-5f;
+}
+
+static int CountModulations(MyPlugin *plugin, const Voice *voice) {
+    int count = 0;
+    for (int32_t m = voice->firstModulation; m != -1; m = plugin->modulations[m].next) count++;
+    return count;
+}
+
+static int CountFreeModulations(MyPlugin *plugin) {
+    int count = 0;
+    for (int32_t m = plugin->firstFreeModulation; m != -1; m = plugin->modulations[m].next) count++;
+    return count;
+}
+
+// The NOTE_ENDs sent by the last process() call, as note IDs.
+static std::vector<int32_t> EndedNotes(HeadlessHost *host) {
+    std::vector<int32_t> noteIDs;
+
+    for (size_t i = 0; i < host->output.size(); i++) {
+        if (HostOutputEvent(host, i)->type == CLAP_EVENT_NOTE_END) {
+            noteIDs.push_back(reinterpret_cast<const clap_event_note_t *>(HostOutputEvent(host, i))->note_id);
+        }
+    }
+
+    return noteIDs;
+}
+
+static void CheckStealing() {
+    HeadlessHost host = {};
+    HostCreate(&host);
+    HostActivate(&host, SAMPLE_RATE);
+    MyPlugin *plugin = PluginFromHost(&host);
+    float left[HOST_BLOCK], right[HOST_BLOCK];
+
+    for (int i = 0; i < VOICE_MAXIMUM; i++) QueueNote(&host, CLAP_EVENT_NOTE_ON, 0, i, i);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    QueueNote(&host, CLAP_EVENT_NOTE_OFF, 0, 10, 10);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(EndedNotes(&host).empty());
+
+    // The released voice goes first, even though it isn't the oldest.
+    host.output.clear();
+    QueueNote(&host, CLAP_EVENT_NOTE_ON, 0, 100, 100);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(EndedNotes(&host) == std::vector<int32_t> { 10 });
+
+    // Then the oldest held one.
+    host.output.clear();
+    QueueNote(&host, CLAP_EVENT_NOTE_ON, 0, 101, 101);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(EndedNotes(&host) == std::vector<int32_t> { 0 });
+
+    // The stolen voice fades out rather than stopping dead, and no longer answers to its note.
+    CHECK(plugin->voices.Length() == VOICE_MAXIMUM + 1);
+    CHECK(plugin->voices[0].stolen && plugin->voices[0].noteID == 0 && plugin->voices[0].envelope > 0.0f);
+    QueueNote(&host, CLAP_EVENT_NOTE_OFF, 0, 0, 0);
+
+    // Once it has, it leaves without a second NOTE_END.
+    for (int i = 0; i < SAMPLE_RATE / 10 / HOST_BLOCK; i++) {
+        host.output.clear();
+        HostProcess(&host, HOST_BLOCK, left, right);
+        CHECK(EndedNotes(&host).empty());
+    }
+
+    CHECK(plugin->voices.Length() == VOICE_MAXIMUM);
+    for (int i = 0; i < plugin->voices.Length(); i++) CHECK(!plugin->voices[i].stolen && plugin->voices[i].held);
+
+    // Stealing faster than stolen voices fade out still never goes beyond the storage reserved on activation.
+    for (int i = 0; i < VOICE_CAPACITY; i++) QueueNote(&host, CLAP_EVENT_NOTE_ON, 1, i, 1000 + i);
+    host.output.clear();
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(EndedNotes(&host).size() == VOICE_CAPACITY);
+    CHECK(plugin->voices.Length() <= VOICE_CAPACITY);
+
+    int held = 0;
+    for (int i = 0; i < plugin->voices.Length(); i++) held += plugin->voices[i].held;
+    CHECK(held == VOICE_MAXIMUM);
+
+    HostDestroy(&host);
+}
+
+static void CheckTuning() {
+    HeadlessHost host = {};
+    HostCreate(&host);
+    HostActivate(&host, SAMPLE_RATE);
+    MyPlugin *plugin = PluginFromHost(&host);
+    float left[HOST_BLOCK], right[HOST_BLOCK];
+
+    // Key 57 is A, at the Tuning parameter's 440 Hz.
+    QueueNote(&host, CLAP_EVENT_NOTE_ON, 0, 57, 1);
+    QueueNote(&host, CLAP_EVENT_NOTE_ON, 0, 64, 2);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    const float a = 440.0f / SAMPLE_RATE, e = a * exp2f(7.0f / 12.0f);
+    CHECK(Near(plugin->voices[0].increment, a) && Near(plugin->voices[1].increment, e));
+
+    // Each expression retunes only the note it targets, and is relative to the key, not to the last expression.
+    QueueTuning(&host, 1, 12.0);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(Near(plugin->voices[0].increment, a * 2.0f) && Near(plugin->voices[1].increment, e));
+    QueueTuning(&host, 1, -0.5);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(Near(plugin->voices[0].increment, a * exp2f(-0.5f / 12.0f)) && Near(plugin->voices[1].increment, e));
+
+    // Changing the reference retunes the keys, and notes already playing keep their expressions on top.
+    HostQueueParameter(&host, P_TUNING, 432.0, 0);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    const float ratio = 432.0f / 440.0f;
+    CHECK(Near(plugin->voices[0].increment, a * ratio * exp2f(-0.5f / 12.0f)) && Near(plugin->voices[1].increment, e * ratio));
+
+    // So does loading a state, and it outlives a change of sample rate.
+    std::vector<uint8_t> state;
+    CHECK(HostSaveState(&host, &state));
+    HostQueueParameter(&host, P_TUNING, 440.0, 0);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(HostLoadState(&host, state));
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(Near(plugin->voices[1].increment, e * ratio));
+    HostDeactivate(&host);
+    HostActivate(&host, SAMPLE_RATE * 2);
+    CHECK(Near(plugin->voices[1].increment, e * ratio / 2.0f));
+
+    HostDestroy(&host);
+}
+
+static void CheckModulation() {
+    HeadlessHost host = {};
+    HostCreate(&host);
+    HostActivate(&host, SAMPLE_RATE);
+    MyPlugin *plugin = PluginFromHost(&host);
+    float left[HOST_BLOCK], right[HOST_BLOCK];
+
+    const struct { int16_t channel, key; } notes[] = { { 0, 60 }, { 0, 64 }, { 0, 67 }, { 1, 60 }, { 1, 72 } };
+    for (int i = 0; i < 5; i++) QueueNote(&host, CLAP_EVENT_NOTE_ON, notes[i].channel, notes[i].key, i);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(CountFreeModulations(plugin) == MODULATION_POOL_SIZE);
+
+    // One channel-wide and one key-wide target, which overlap on the first voice.
+    QueueModulation(&host, 0, -1, -0.5);
+    QueueModulation(&host, -1, 60, -0.25);
+    HostProcess(&host, HOST_BLOCK, left, right);
+
+    for (int i = 0; i < 5; i++) {
+        const Voice *voice = &plugin->voices[i];
+        CHECK(CountModulations(plugin, voice) == (voice->channel == 0 || voice->key == 60 ? 1 : 0));
+    }
+
+    CHECK(plugin->modulations[plugin->voices[0].firstModulation].target == -0.25f); // Set last.
+    CHECK(plugin->modulations[plugin->voices[1].firstModulation].target == -0.5f);
+    CHECK(CountFreeModulations(plugin) == MODULATION_POOL_SIZE - 4);
+
+    // Entries stay in use while the modulation fades out, and are all given back once it has.
+    QueueModulation(&host, 0, -1, 0.0);
+    QueueModulation(&host, 1, 60, 0.0);
+    HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(CountFreeModulations(plugin) == MODULATION_POOL_SIZE - 4);
+
+    for (int i = 0; i < SAMPLE_RATE / 5 / HOST_BLOCK; i++) HostProcess(&host, HOST_BLOCK, left, right);
+    CHECK(CountFreeModulations(plugin) == MODULATION_POOL_SIZE);
+    for (int i = 0; i < 5; i++) CHECK(plugin->voices[i].firstModulation == -1);
+
+    HostDestroy(&host);
+}
+
+int main(int, char **argv) {
+    clap_entry.init(argv[0]);
+    CheckStealing();
+    CheckTuning();
+    CheckModulation();
+    clap_entry.deinit();
+    return testFailures != 0;
+}
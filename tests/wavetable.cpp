@@ -0,0 +1,118 @@
+#include "headless_host.h"
+#include "plugin.h"
+#include <cmath>
+#include <filesystem>
+
+// Renders notes across the keyboard from a wavetable file, in both modes, and compares them with the built-in sine.
+// Each mip level of the test table is a sine with its own amplitude, so the level of the output shows which mip was
+// read. The table is short enough that linear interpolation is measurably less accurate than Hermite, so the error
+// shows which reader was used.
+
+#define SAMPLE_RATE (48000)
+#define HOST_BLOCK (256)
+#define TEST_FRAME_LENGTH (64)
+#define TEST_MIP_COUNT (6) // Down to a single harmonic.
+
+static float MipAmplitude(uint32_t mip) {
+    return (mip + 1) / 8.0f;
+}
+
+static bool WriteTestWavetable(const std::filesystem::path &path) {
+    FILE *file = fopen(path.string().c_str(), "wb");
+    if (!file) return false;
+
+    WavetableHeader header = {};
+    memcpy(header.magic, WAVETABLE_MAGIC, sizeof(header.magic));
+    header.version = WAVETABLE_VERSION;
+    header.frameLength = TEST_FRAME_LENGTH;
+    header.mipCount = TEST_MIP_COUNT;
+    fwrite(&header, sizeof(header), 1, file);
+
+    for (uint32_t mip = 0; mip < TEST_MIP_COUNT; mip++) {
+        float level[TEST_FRAME_LENGTH + 1];
+        for (uint32_t i = 0; i <= TEST_FRAME_LENGTH; i++) level[i] = MipAmplitude(mip) * sinf(i * 2.0f * 3.14159265f / TEST_FRAME_LENGTH);
+        fwrite(level, sizeof(float), TEST_FRAME_LENGTH + 1, file);
+    }
+
+    return fclose(file) == 0;
+}
+
+static void Create(HeadlessHost *host, clap_plugin_render_mode mode, bool wavetable) {
+    float left[HOST_BLOCK], right[HOST_BLOCK];
+    HostCreate(host);
+    CHECK(host->render->set(host->plugin, mode));
+    HostActivate(host, SAMPLE_RATE);
+
+    // The audio thread asks the main thread to map the file, and picks it up on the next block.
+    if (wavetable) {
+        HostQueueParameter(host, P_WAVETABLE, 1.0, 0);
+        HostProcess(host, HOST_BLOCK, left, right);
+        CHECK(host->callbackRequests == 1);
+        host->plugin->on_main_thread(host->plugin);
+        HostProcess(host, HOST_BLOCK, left, right);
+        CHECK(static_cast<MyPlugin *>(host->plugin->plugin_data)->wavetable);
+    }
+}
+
+static std::vector<float> RenderNote(HeadlessHost *host, int16_t key) {
+    std::vector<float> rendered;
+    float left[HOST_BLOCK], right[HOST_BLOCK];
+    HostQueueNote(host, CLAP_EVENT_NOTE_ON, key, key, 0);
+
+    for (uint32_t block = 0; block < 8; block++) {
+        HostProcess(host, HOST_BLOCK, left, right);
+        rendered.insert(rendered.end(), left, left + HOST_BLOCK);
+    }
+
+    // Choked rather than released, so the next note starts from silence.
+    HostQueueNote(host, CLAP_EVENT_NOTE_CHOKE, key, key, 0);
+    HostProcess(host, HOST_BLOCK, left, right);
+    return rendered;
+}
+
+// The largest difference from the sine scaled to the given amplitude, relative to that amplitude.
+static float RelativeError(const std::vector<float> &rendered, const std::vector<float> &sine, float amplitude) {
+    float error = 0.0f;
+    for (size_t i = 0; i < rendered.size(); i++) error = std::max(error, fabsf(rendered[i] - sine[i] * amplitude));
+    return error / (amplitude * 0.1f); // The default volume of 0.5, times the voice's gain of 0.2.
+}
+
+int main(int, char **) {
+    std::error_code error;
+    const std::filesystem::path folder = std::filesystem::temp_directory_path() / "test_wavetable";
+    std::filesystem::create_directories(folder / "wavetables", error);
+    if (!WriteTestWavetable(folder / "wavetables" / "test.wt")) return 1;
+    clap_entry.init((folder / "test.clap").string().c_str());
+    CHECK(WavetableCount() == 1);
+
+    // The offline sine is computed with sinf, so it's the reference for both readers.
+    HeadlessHost sine = {}, realtime = {}, offline = {};
+    Create(&sine, CLAP_RENDER_OFFLINE, false);
+    Create(&realtime, CLAP_RENDER_REALTIME, true);
+    Create(&offline, CLAP_RENDER_OFFLINE, true);
+
+    // From a mip per octave, up to a key beyond the last mip, which must stay on it.
+    const int16_t keys[] = { 21, 57, 69, 81, 93, 105, 117, 127 };
+
+    for (int16_t key : keys) {
+        const float increment = 440.0f * exp2f((key - 57.0f) / 12.0f) / SAMPLE_RATE;
+        const auto mip = static_cast<uint32_t>(std::clamp(ceilf(log2f(TEST_FRAME_LENGTH * increment)), 0.0f, TEST_MIP_COUNT - 1.0f));
+
+        const std::vector<float> reference = RenderNote(&sine, key);
+        const float realtimeError = RelativeError(RenderNote(&realtime, key), reference, MipAmplitude(mip));
+        const float offlineError = RelativeError(RenderNote(&offline, key), reference, MipAmplitude(mip));
+        printf("key %3d, mip %u: linear error %g, Hermite error %g\n", key, mip, realtimeError, offlineError);
+
+        // A neighbouring mip would be off by at least an eighth.
+        CHECK(realtimeError < 2e-3f);
+        CHECK(offlineError < 2e-4f);
+        CHECK(realtimeError > 10.0f * offlineError);
+    }
+
+    HostDestroy(&sine);
+    HostDestroy(&realtime);
+    HostDestroy(&offline);
+    clap_entry.deinit();
+    std::filesystem::remove_all(folder, error);
+    return testFailures != 0;
+}